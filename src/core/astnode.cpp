@@ -34,8 +34,7 @@ Core::AstNodeList AstNode::childrenNodes() const
 {
     QList<AstNode> children;
     if (auto n = node()) {
-        const auto childNodes = n->children();
-        for (const auto &node : childNodes) {
+        for (const auto &node : n->childRange()) {
             children.append(AstNode(node, document()));
         }
     }
@@ -55,7 +54,9 @@ std::optional<treesitter::Node> AstNode::node() const
     }
 
     if (auto doc = document()) {
-        return doc->m_treeSitterHelper->syntaxTree()->rootNode().descendantForRange(startPos(), endPos());
+        if (const auto &tree = doc->m_treeSitterHelper->syntaxTree()) {
+            return tree->rootNode().descendantForRange(startPos(), endPos());
+        }
     }
     return std::nullopt;
 }
@@ -15,6 +15,8 @@
 #include "lsp_utils.h"
 #include "project.h"
 #include "querymatch.h"
+#include "querymatch_p.h"
+#include "querymatchiterator.h"
 #include "rangemark.h"
 #include "symbol.h"
 #include "treesitter/predicates.h"
@@ -55,7 +57,7 @@ CodeDocument::CodeDocument(Type type, QObject *parent)
     : TextDocument(type, parent)
     , m_treeSitterHelper(std::make_unique<TreeSitterHelper>(this))
 {
-    connect(textEdit()->document(), &QTextDocument::contentsChange, this, &CodeDocument::changeContent);
+    connect(this, &TextDocument::contentsChange, this, &CodeDocument::changeContent);
 }
 
 void CodeDocument::setLspClient(Lsp::Client *client)
@@ -77,7 +79,7 @@ bool CodeDocument::hasLspClient() const
  */
 Symbol *CodeDocument::currentSymbol(const std::function<bool(const Symbol &)> &filterFunc) const
 {
-    const int pos = textEdit()->textCursor().position();
+    const int pos = textCursor().position();
 
     const auto symbolList = symbols();
     for (auto symbol : symbolList | std::views::reverse) {
@@ -160,7 +162,7 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Transforms, patterns);
 const Core::Symbol *CodeDocument::symbolUnderCursor() const
 {
     const auto containsCursor = [this](const Core::Symbol *symbol) {
-        return symbol->selectionRange().contains(textEdit()->textCursor().position());
+        return symbol->selectionRange().contains(textCursor().position());
     };
 
     const auto symbols = this->symbols();
@@ -180,7 +182,7 @@ const Core::Symbol *CodeDocument::symbolUnderCursor() const
  */
 QString CodeDocument::hover() const
 {
-    return hover(textEdit()->textCursor().position());
+    return hover(textCursor().position());
 }
 
 QString CodeDocument::hover(int position, std::function<void(const QString &)> asyncCallback /*  = {} */) const
@@ -290,7 +292,7 @@ Document *CodeDocument::followSymbol()
     // Set the cursor position to the beginning of any selected text.
     // That way, calling followSymbol twice in a row causes Clangd
     // to switch between declaration and definition.
-    auto cursor = textEdit()->textCursor();
+    auto cursor = textCursor();
     return followSymbol(cursor.selectionStart());
 }
 
@@ -300,7 +302,7 @@ Document *CodeDocument::followSymbol()
 // - Go to the definition, if the symbol under cursor is a declaration
 Document *CodeDocument::followSymbol(int pos)
 {
-    auto cursor = textEdit()->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(pos);
 
     Lsp::DeclarationParams params;
@@ -362,7 +364,7 @@ Document *CodeDocument::switchDeclarationDefinition()
     if (!checkClient())
         return {};
 
-    auto cursor = textEdit()->textCursor();
+    auto cursor = textCursor();
     auto symbolList = symbols();
 
     auto currentFunction = kdalgorithms::find_if(symbolList, [&cursor](const auto &symbol) {
@@ -407,6 +409,9 @@ int CodeDocument::selectLargerSyntaxNode(int count /* = 1*/)
 {
     LOG_AND_MERGE("CodeDocument::selectLargerSyntaxNode", LOG_ARG("count", count));
 
+    if (!m_treeSitterHelper->syntaxTree()) {
+        LOG_RETURN("pos", position());
+    }
     auto currentNode = m_treeSitterHelper->nodeCoveringRange(selectionStart(), selectionEnd());
 
     auto matchesCurrentSelection = static_cast<int>(currentNode.startPosition()) == selectionStart()
@@ -446,24 +451,29 @@ int CodeDocument::selectSmallerSyntaxNode(int count /* = 1*/)
 {
     LOG_AND_MERGE("CodeDocument::selectSmallerSyntaxNode", LOG_ARG("count", count));
 
-    auto smallerNodes =
-        kdalgorithms::filtered(m_treeSitterHelper->nodesInRange(createRangeMark()), [](const auto &node) {
-            return node.isNamed();
-        });
+    const auto nodesInRange = m_treeSitterHelper->nodesInRange(createRangeMark());
+    auto firstNamed = std::ranges::find_if(nodesInRange, &treesitter::Node::isNamed);
+    std::optional<treesitter::Node> smallerNode;
+    if (firstNamed != nodesInRange.cend()) {
+        smallerNode = *firstNamed;
+    }
 
     std::optional<treesitter::Node> node;
     for (/*count already initialized*/; count > 0; --count) {
-        if (smallerNodes.isEmpty()) {
+        if (!smallerNode.has_value()) {
             break;
         }
-        node = smallerNodes.first();
+        node = smallerNode;
         auto matchesCurrentSelection = static_cast<int>(node->startPosition()) == selectionStart()
             && static_cast<int>(node->endPosition()) == selectionEnd();
         // If the first found node matches the current selection exactly, we need to search one additional time.
         if (matchesCurrentSelection) {
             ++count;
         }
-        smallerNodes = node->namedChildren();
+        smallerNode.reset();
+        if (node->namedChildCount() > 0) {
+            smallerNode = node->namedChild(0);
+        }
     }
 
     if (node.has_value()) {
@@ -515,6 +525,9 @@ int CodeDocument::selectNextSyntaxNode(int count /*= 1*/)
 {
     LOG_AND_MERGE("CodeDocument::selectNextSyntaxNode", LOG_ARG("count", count));
 
+    if (!m_treeSitterHelper->syntaxTree()) {
+        LOG_RETURN("pos", position());
+    }
     auto node = m_treeSitterHelper->nodeCoveringRange(selectionStart(), selectionEnd());
 
     auto target = findSibling(node, &treesitter::Node::nextNamedSibling, count);
@@ -542,6 +555,9 @@ int CodeDocument::selectPreviousSyntaxNode(int count /*= 1*/)
 {
     LOG_AND_MERGE("CodeDocument::selectPreviousSyntaxNode", LOG_ARG("count", count));
 
+    if (!m_treeSitterHelper->syntaxTree()) {
+        LOG_RETURN("pos", position());
+    }
     auto node = m_treeSitterHelper->nodeCoveringRange(selectionStart(), selectionEnd());
 
     auto target = findSibling(node, &treesitter::Node::previousNamedSibling, count);
@@ -596,7 +612,7 @@ void CodeDocument::didOpen()
     Lsp::DidOpenTextDocumentParams params;
     params.textDocument.uri = toUri();
     params.textDocument.version = revision();
-    params.textDocument.text = textEdit()->toPlainText().toStdString();
+    params.textDocument.text = document()->toPlainText().toStdString();
     params.textDocument.languageId = m_lspClient->languageId();
 
     m_lspClient->didOpen(std::move(params));
@@ -628,7 +644,8 @@ std::unique_ptr<TreeSitterHelper> &CodeDocument::helper()
     return m_treeSitterHelper;
 }
 
-std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std::shared_ptr<treesitter::Query> &query)
+std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std::shared_ptr<treesitter::Query> &query,
+                                                                       uint32_t matchLimit)
 {
     const auto &tree = m_treeSitterHelper->syntaxTree();
     if (!tree || !query) {
@@ -637,6 +654,7 @@ std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std
 
     treesitter::QueryCursor cursor;
     cursor.setProgressCallback(ScriptDialogItem::updateProgress);
+    cursor.setMatchLimit(matchLimit);
     cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(text()));
     return cursor;
 }
@@ -665,11 +683,33 @@ Core::QueryMatchList CodeDocument::query(const std::shared_ptr<treesitter::Query
 
     auto matches = cursor->allRemainingMatches();
 
-    return kdalgorithms::transformed<Core::QueryMatchList>(matches, [this](const treesitter::QueryMatch &match) {
-        return QueryMatch(*this, match);
+    // All the matches share the same store for their captures.
+    auto store = std::make_shared<QueryCaptureStore>(this, query);
+    return kdalgorithms::transformed<Core::QueryMatchList>(matches, [&store](const treesitter::QueryMatch &match) {
+        return QueryMatch(store, match);
     });
 }
 
+QList<Core::QueryMatchList> CodeDocument::queryMany(const std::shared_ptr<treesitter::Query> &query)
+{
+    auto cursor = createQueryCursor(query);
+    if (!cursor.has_value()) {
+        return {};
+    }
+
+    QList<Core::QueryMatchList> results(query->subQueryCount());
+    auto store = std::make_shared<QueryCaptureStore>(this, query);
+    QList<treesitter::QueryCursor::MatchSink> sinks;
+    sinks.reserve(results.size());
+    for (auto &matches : results) {
+        sinks.emplace_back([&store, &matches](const treesitter::QueryMatch &match) {
+            matches.emplace_back(store, match);
+        });
+    }
+    cursor->dispatchRemainingMatches(sinks);
+    return results;
+}
+
 /*!
  * \qmlmethod array<QueryMatch> CodeDocument::query(string query)
  * Runs the given Tree-sitter `query` and returns the list of matches.
@@ -706,6 +746,83 @@ Core::QueryMatch CodeDocument::queryFirst(const QString &query)
     return this->queryFirst(m_treeSitterHelper->constructQuery(query));
 }
 
+/*!
+ * \qmlmethod array<array<QueryMatch>> CodeDocument::queryMany(array<string> queries)
+ * Runs all the given Tree-sitter `queries` at once, and returns the list of matches for each query.
+ *
+ * This is faster than calling `query` for each of the queries, as the document is only traversed once.
+ *
+ * ```js
+ * let [classes, functions] = document.queryMany(["(class_specifier) @class", "(function_definition) @function"]);
+ * ```
+ *
+ * \sa CodeDocument::query
+ */
+QVariantList CodeDocument::queryMany(const QStringList &queries)
+{
+    LOG("CodeDocument::queryMany", LOG_ARG("queries", queries));
+
+    const auto results = queryMany(m_treeSitterHelper->constructQuery(queries));
+    if (results.isEmpty()) {
+        // Keep one (empty) list per query, even if the queries are invalid.
+        return QVariantList(queries.size(), QVariant::fromValue(Core::QueryMatchList()));
+    }
+    return kdalgorithms::transformed<QVariantList>(results, [](const Core::QueryMatchList &matches) {
+        return QVariant::fromValue(matches);
+    });
+}
+
+/*!
+ * \qmlmethod QueryMatchIterator CodeDocument::queryIterator(string query, int matchLimit = 0)
+ * Runs the given Tree-sitter `query` and returns an iterator over its matches.
+ *
+ * The matches are only searched for when they are requested, so this is faster than `query` if you don't need all
+ * the matches, and uses less memory on large documents.
+ *
+ * If `matchLimit` is not 0, it limits the number of matches Tree-sitter keeps in progress while running the query,
+ * bounding the memory it uses. Some matches may then be missing, see `QueryMatchIterator::exceededMatchLimit`.
+ *
+ * ```js
+ * let iterator = document.queryIterator("(call_expression) @call");
+ * let firstCalls = iterator.take(10);
+ * ```
+ *
+ * \sa CodeDocument::query
+ */
+Core::QueryMatchIterator *CodeDocument::queryIterator(const QString &query, int matchLimit)
+{
+    LOG("CodeDocument::queryIterator", LOG_ARG("query", query), LOG_ARG("matchLimit", matchLimit));
+
+    auto cursor =
+        createQueryCursor(m_treeSitterHelper->constructQuery(query), static_cast<uint32_t>(std::max(matchLimit, 0)));
+    // Without a parent, the iterator is owned by the JavaScript engine when returned to a script.
+    return new QueryMatchIterator(this, std::move(cursor));
+}
+
+/*!
+ * \qmlmethod ParseStatus CodeDocument::parseStatus()
+ * Returns the status of the Tree-sitter parse of the document, parsing it if needed. It can be one of those values:
+ *
+ * - `CodeDocument.ParseSucceeded`: the document was parsed
+ * - `CodeDocument.ParseFailed`: Tree-sitter failed to parse the document
+ * - `CodeDocument.ParseTimedOut`: parsing took longer than the `/treesitter/parse_timeout` setting (in milliseconds)
+ * - `CodeDocument.ParseCancelled`: parsing was cancelled
+ * - `CodeDocument.ParseSkipped`: the document is larger than the `/treesitter/max_file_size` setting (in characters)
+ *
+ * If the document couldn't be parsed, it falls back to a text-only mode: queries and symbols return empty results,
+ * but the text can still be edited. The document is only parsed again once it's modified.
+ */
+Core::CodeDocument::ParseStatus CodeDocument::parseStatus() const
+{
+    LOG("CodeDocument::parseStatus");
+    return m_treeSitterHelper->parseStatus();
+}
+
+void CodeDocument::cancelParsing()
+{
+    m_treeSitterHelper->cancelParsing();
+}
+
 /**
  * \qmlmethod array<QueryMatch> CodeDocument::queryInRange(RangeMark range, string query)
  *
@@ -734,13 +851,16 @@ Core::QueryMatchList CodeDocument::queryInRange(const Core::RangeMark &range, co
     if (!tsQuery)
         return {};
 
+    // The text is shared by the predicates of all the nodes.
+    const auto source = text();
+    auto store = std::make_shared<QueryCaptureStore>(this, tsQuery);
     treesitter::QueryCursor cursor;
     Core::QueryMatchList matches;
     for (const treesitter::Node &node : nodes) {
-        cursor.execute(tsQuery, node, std::make_unique<treesitter::Predicates>(text()));
+        cursor.execute(tsQuery, node, std::make_unique<treesitter::Predicates>(source));
         matches.append(kdalgorithms::transformed<QList<QueryMatch>>(cursor.allRemainingMatches(),
-                                                                    [this](const treesitter::QueryMatch &match) {
-                                                                        return QueryMatch(*this, match);
+                                                                    [&store](const treesitter::QueryMatch &match) {
+                                                                        return QueryMatch(store, match);
                                                                     }));
     }
     return matches;
@@ -753,7 +873,8 @@ int CodeDocument::revision() const
 
 bool CodeDocument::checkClient() const
 {
-    Q_ASSERT(textEdit());
+    // The language server must know about the changes of a batch edit before being asked anything.
+    const_cast<CodeDocument *>(this)->flushContentsChange();
     if (!client()) {
         spdlog::error("CodeDocument {} has no LSP client - API not available", fileName());
         return false;
@@ -768,7 +889,7 @@ void CodeDocument::changeContentLsp(int position, int charsRemoved, int charsAdd
     Q_UNUSED(charsAdded)
 
     // TODO: Keep copy of previous string around, so we can find the oldEndPosition.
-    // const auto document = textEdit()->document();
+    // const auto document = document();
     // const auto startblock = document->findBlock(position);
     // spdlog::warn("start point: {}, {}", startblock.blockNumber(), position - startblock.position());
 
@@ -817,15 +938,10 @@ void CodeDocument::changeContentLsp(int position, int charsRemoved, int charsAdd
 
 void CodeDocument::changeContentTreeSitter(int position, int charsRemoved, int charsAdded)
 {
-    Q_UNUSED(position)
-    Q_UNUSED(charsRemoved)
-    Q_UNUSED(charsAdded)
-
     // Note: This invalidates all existing treesitter::Node instances of this tree!
     // Only use treesitter nodes as long as you're certain the document isn't edited!
-    // TODO: If we keep the old string around, we could implement incremental parsing here.
-    // If TreeSitter parsing ever becomes a performance bottleneck, this would be where to fix it.
-    m_treeSitterHelper->clear();
+    // The tree is edited, so that the next parse is incremental.
+    m_treeSitterHelper->edit(position, charsRemoved, charsAdded);
 }
 
 void CodeDocument::changeContent(int position, int charsRemoved, int charsAdded)
@@ -845,8 +961,11 @@ void CodeDocument::changeContent(int position, int charsRemoved, int charsAdded)
 
 AstNode CodeDocument::astNodeAt(int pos)
 {
-    const auto root = m_treeSitterHelper->syntaxTree()->rootNode();
-    if (const auto node = root.descendantForRange(pos, pos); !node.isNull()) {
+    const auto &tree = m_treeSitterHelper->syntaxTree();
+    if (!tree) {
+        return {};
+    }
+    if (const auto node = tree->rootNode().descendantForRange(pos, pos); !node.isNull()) {
         return AstNode(node, this);
     }
     return {};
@@ -13,6 +13,7 @@
 #include "astnode.h"
 #include "lsp/client.h"
 #include "querymatch.h"
+#include "querymatchiterator.h"
 #include "symbol.h"
 #include "textdocument.h"
 #include "treesitter/parser.h"
@@ -43,6 +44,15 @@ class CodeDocument : public TextDocument
     Q_OBJECT
 
 public:
+    enum ParseStatus {
+        ParseSucceeded,
+        ParseFailed,
+        ParseTimedOut,
+        ParseCancelled,
+        ParseSkipped,
+    };
+    Q_ENUM(ParseStatus)
+
     ~CodeDocument() override;
 
     void setLspClient(Lsp::Client *client);
@@ -55,6 +65,9 @@ public:
     Q_INVOKABLE Core::QueryMatchList query(const QString &query);
     Q_INVOKABLE Core::QueryMatch queryFirst(const QString &query);
     Q_INVOKABLE Core::QueryMatchList queryInRange(const Core::RangeMark &range, const QString &query);
+    Q_INVOKABLE QVariantList queryMany(const QStringList &queries);
+    Q_INVOKABLE Core::QueryMatchIterator *queryIterator(const QString &query, int matchLimit = 0);
+    Q_INVOKABLE Core::CodeDocument::ParseStatus parseStatus() const;
 
     // This overload exists for improved performance. It's not user-facing API.
     //
@@ -63,6 +76,9 @@ public:
     // So allow this for outside users.
     QList<Core::QueryMatch> query(const std::shared_ptr<treesitter::Query> &query);
     Core::QueryMatch queryFirst(const std::shared_ptr<treesitter::Query> &query);
+    // Runs a query combining several queries (see TreeSitterHelper::constructQuery), and returns
+    // the matches of each of the combined queries.
+    QList<Core::QueryMatchList> queryMany(const std::shared_ptr<treesitter::Query> &query);
 
     bool hasLspClient() const;
 
@@ -82,6 +98,10 @@ public:
 
     virtual QList<treesitter::Range> includedRanges() const;
 
+    // Stops the current parse of the document, or the pending one if it was modified since the last parse.
+    // This can be called from another thread.
+    void cancelParsing();
+
 public slots:
     void selectSymbol(const QString &name, int options = NoFindFlags);
 
@@ -111,7 +131,8 @@ private:
     bool checkClient() const;
     Document *followSymbol(int pos);
 
-    std::optional<treesitter::QueryCursor> createQueryCursor(const std::shared_ptr<treesitter::Query> &query);
+    std::optional<treesitter::QueryCursor> createQueryCursor(const std::shared_ptr<treesitter::Query> &query,
+                                                             uint32_t matchLimit = 0);
 
     void changeContent(int position, int charsRemoved, int charsAdded);
     void changeContentLsp(int position, int charsRemoved, int charsAdded);
@@ -10,14 +10,100 @@
 
 #include "codedocument_p.h"
 #include "codedocument.h"
+#include "settings.h"
 #include "treesitter/languages.h"
+#include "treesitter/query_cache.h"
 #include "treesitter/tree_cursor.h"
 #include "utils/log.h"
 
+#include <QElapsedTimer>
+#include <QPlainTextEdit>
+#include <QTextBlock>
+#include <algorithm>
 #include <kdalgorithms.h>
 
 namespace Core {
 
+namespace {
+
+// Reads the text of a QTextDocument for tree-sitter, a few blocks at a time, so parsing doesn't need a copy of the
+// whole text. The text read is the same as QTextDocument::toPlainText.
+class TextDocumentInput
+{
+public:
+    explicit TextDocumentInput(const QTextDocument *document)
+        : m_document(document)
+        , m_length(document->characterCount() - 1)
+        , m_next(document->firstBlock())
+    {
+    }
+
+    TSInput input()
+    {
+        return TSInput {.payload = this, .read = &TextDocumentInput::read, .encoding = TSInputEncodingUTF16};
+    }
+
+private:
+    static constexpr int ChunkSize = 16 * 1024;
+
+    static const char *read(void *payload, uint32_t byteIndex, TSPoint /*position*/, uint32_t *bytesRead)
+    {
+        return static_cast<TextDocumentInput *>(payload)->readAt(static_cast<int>(byteIndex / sizeof(QChar)),
+                                                                 bytesRead);
+    }
+
+    const char *readAt(int position, uint32_t *bytesRead)
+    {
+        // Keeps the capacity, so the chunk is only allocated once.
+        m_chunk.resize(0);
+        if (position < m_length) {
+            // The text is mostly read in order, so the chunk usually starts at the block following the last chunk.
+            auto block = m_next.isValid() && m_next.position() == position ? m_next : m_document->findBlock(position);
+            int offset = position - block.position();
+            while (block.isValid() && m_chunk.size() < ChunkSize) {
+                m_chunk += QStringView(block.text()).sliced(offset);
+                offset = 0;
+                block = block.next();
+                if (block.isValid())
+                    m_chunk += u'\n';
+            }
+            m_next = block;
+            normalizeChunk();
+        }
+
+        *bytesRead = static_cast<uint32_t>(m_chunk.size() * sizeof(QChar));
+        // The chunk must stay valid until the next read.
+        return reinterpret_cast<const char *>(m_chunk.constData());
+    }
+
+    // Same replacements as QTextDocument::toPlainText.
+    void normalizeChunk()
+    {
+        for (auto &c : m_chunk) {
+            switch (c.unicode()) {
+            case 0xfdd0: // QTextBeginningOfFrame
+            case 0xfdd1: // QTextEndOfFrame
+            case QChar::ParagraphSeparator:
+            case QChar::LineSeparator:
+                c = u'\n';
+                break;
+            case QChar::Nbsp:
+                c = u' ';
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    const QTextDocument *m_document;
+    const int m_length;
+    QTextBlock m_next;
+    QString m_chunk;
+};
+
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // TreeSitterHelper
 ///////////////////////////////////////////////////////////////////////////////
@@ -28,15 +114,103 @@ TreeSitterHelper::TreeSitterHelper(CodeDocument *document)
 
 void TreeSitterHelper::clear()
 {
+    dropStaleCancellation();
     m_tree = {};
+    m_oldTree = {};
+    m_parseStatus = {};
+    m_lineLengths.clear();
+    m_textLength = 0;
+    m_symbols.clear();
+    m_flags &= ~HasSymbols;
+}
+
+// Apply a change of the document to the syntax tree, so the next call to syntaxTree() only needs to reparse
+// the parts of the document that actually changed.
+// This must be called for every change of the document, with the arguments of TextDocument::contentsChange.
+void TreeSitterHelper::edit(int position, int charsRemoved, int charsAdded)
+{
+    dropStaleCancellation();
     m_symbols.clear();
     m_flags &= ~HasSymbols;
+    m_parseStatus = {};
+
+    if (m_tree) {
+        m_oldTree = std::move(m_tree);
+        m_tree = {};
+    }
+    if (!m_oldTree) {
+        clear();
+        return;
+    }
+
+    const auto document = m_document->document();
+
+    // QTextDocument may report a change going past the end of the text (for example when the whole text is set),
+    // including the final paragraph separator. There's nothing to reuse in this case.
+    if (position + charsRemoved > m_textLength
+        || m_textLength - charsRemoved + charsAdded != document->characterCount() - 1) {
+        clear();
+        return;
+    }
+
+    // The text before the change didn't move, so the start point can be computed on the new document.
+    const auto startBlock = document->findBlock(position);
+    const int startRow = startBlock.blockNumber();
+    const int startColumn = position - startBlock.position();
+
+    int oldEndRow = startRow;
+    int oldEndColumn = startColumn + charsRemoved;
+    while (oldEndColumn > m_lineLengths[oldEndRow]) {
+        oldEndColumn -= m_lineLengths[oldEndRow] + 1;
+        ++oldEndRow;
+    }
+
+    const int newEnd = position + charsAdded;
+    const auto newEndBlock = document->findBlock(newEnd);
+    const int newEndRow = newEndBlock.blockNumber();
+    const int newEndColumn = newEnd - newEndBlock.position();
+
+    // Tree-sitter works on bytes, and columns are in bytes as well.
+    auto toPoint = [](int row, int column) {
+        return TSPoint {static_cast<uint32_t>(row), static_cast<uint32_t>(column * sizeof(QChar))};
+    };
+    TSInputEdit edit;
+    edit.start_byte = static_cast<uint32_t>(position * sizeof(QChar));
+    edit.old_end_byte = static_cast<uint32_t>((position + charsRemoved) * sizeof(QChar));
+    edit.new_end_byte = static_cast<uint32_t>(newEnd * sizeof(QChar));
+    edit.start_point = toPoint(startRow, startColumn);
+    edit.old_end_point = toPoint(oldEndRow, oldEndColumn);
+    edit.new_end_point = toPoint(newEndRow, newEndColumn);
+    m_oldTree->edit(edit);
+
+    // Update the line lengths of the lines touched by the change.
+    std::vector<int> newLengths;
+    newLengths.reserve(newEndRow - startRow + 1);
+    for (auto block = startBlock; block.isValid() && block.blockNumber() <= newEndRow; block = block.next()) {
+        newLengths.push_back(block.length() - 1);
+    }
+    const auto first = m_lineLengths.begin() + startRow;
+    m_lineLengths.insert(m_lineLengths.erase(first, first + (oldEndRow - startRow + 1)), newLengths.cbegin(),
+                         newLengths.cend());
+    m_textLength += charsAdded - charsRemoved;
+}
+
+void TreeSitterHelper::initializeLineLengths()
+{
+    const auto document = m_document->document();
+    m_lineLengths.clear();
+    m_lineLengths.reserve(document->blockCount());
+    for (auto block = document->firstBlock(); block.isValid(); block = block.next()) {
+        m_lineLengths.push_back(block.length() - 1);
+    }
+    m_textLength = document->characterCount() - 1;
 }
 
 treesitter::Parser &TreeSitterHelper::parser()
 {
     if (!m_parser) {
         m_parser = treesitter::Parser(treesitter::Parser::getLanguage(m_document->type()));
+        m_parser->setCancellationFlag(&m_cancellationFlag);
     }
 
     // Regarding const-ness:
@@ -47,25 +221,98 @@ treesitter::Parser &TreeSitterHelper::parser()
 
 std::optional<treesitter::Tree> &TreeSitterHelper::syntaxTree()
 {
-    if (!m_tree) {
-        auto &parser = this->parser();
-        if (!parser.setIncludedRanges(m_document->includedRanges())) {
-            spdlog::warn("TreeSitterHelper::syntaxTree: Unable to set the included ranges on the treesitter parser!");
-            parser.setIncludedRanges({});
-        }
-        m_tree = parser.parseString(m_document->text());
-        if (!m_tree) {
-            spdlog::warn("CodeDocument::syntaxTree: Failed to parse document {}!", m_document->fileName());
-        }
+    // The tree is needed in the middle of a batch edit, it has to know about the changes done so far.
+    m_document->flushContentsChange();
+    if (!m_tree && !m_parseStatus) {
+        parse();
     }
     return m_tree;
 }
 
+CodeDocument::ParseStatus TreeSitterHelper::parseStatus()
+{
+    syntaxTree();
+    return m_parseStatus.value_or(CodeDocument::ParseFailed);
+}
+
+void TreeSitterHelper::cancelParsing()
+{
+    std::atomic_ref<size_t>(m_cancellationFlag).store(1);
+}
+
+// Called before the document is modified: if no parse was pending, a cancellation requested since the last parse
+// doesn't apply to the parse needed by the new text.
+void TreeSitterHelper::dropStaleCancellation()
+{
+    if (m_parseStatus)
+        std::atomic_ref<size_t>(m_cancellationFlag).store(0);
+}
+
+void TreeSitterHelper::parse()
+{
+    const auto document = m_document->document();
+    const auto settings = Settings::instance();
+
+    // Fall back to a text-only mode for files too large to be parsed in a reasonable time.
+    const auto maxFileSize = settings->value<int>(Settings::TreeSitterMaxFileSize);
+    if (maxFileSize > 0 && document->characterCount() - 1 > maxFileSize) {
+        spdlog::warn("TreeSitterHelper::syntaxTree: Document {} is too large to be parsed ({} characters)",
+                     m_document->fileName(), document->characterCount() - 1);
+        m_parseStatus = CodeDocument::ParseSkipped;
+        std::atomic_ref<size_t>(m_cancellationFlag).store(0);
+        m_oldTree = {};
+        m_lineLengths.clear();
+        return;
+    }
+
+    auto &parser = this->parser();
+    if (!parser.setIncludedRanges(m_document->includedRanges())) {
+        spdlog::warn("TreeSitterHelper::syntaxTree: Unable to set the included ranges on the treesitter parser!");
+        parser.setIncludedRanges({});
+    }
+    const auto timeout = std::chrono::milliseconds(settings->value<int>(Settings::TreeSitterParseTimeout));
+    parser.setTimeout(std::max(timeout, std::chrono::milliseconds::zero()));
+
+    // Reuse the previous tree if possible, tree-sitter will then only reparse the edited parts.
+    // Read the text directly from the QTextDocument, instead of copying it with CodeDocument::text.
+    TextDocumentInput input(document);
+    QElapsedTimer timer;
+    timer.start();
+    m_tree = parser.parse(input.input(), m_oldTree ? &m_oldTree.value() : nullptr);
+    m_oldTree = {};
+    // The cancellation is consumed by the parse, so a cancellation requested just before it started isn't lost.
+    const bool cancelled = std::atomic_ref<size_t>(m_cancellationFlag).exchange(0) != 0;
+
+    if (m_tree) {
+        m_parseStatus = CodeDocument::ParseSucceeded;
+        if (m_lineLengths.empty()) {
+            initializeLineLengths();
+        }
+        return;
+    }
+
+    if (cancelled) {
+        spdlog::warn("TreeSitterHelper::syntaxTree: Parsing document {} was cancelled", m_document->fileName());
+        m_parseStatus = CodeDocument::ParseCancelled;
+    } else if (timeout.count() > 0 && timer.elapsed() >= timeout.count()) {
+        spdlog::warn("TreeSitterHelper::syntaxTree: Parsing document {} timed out after {}ms", m_document->fileName(),
+                     timeout.count());
+        m_parseStatus = CodeDocument::ParseTimedOut;
+    } else {
+        spdlog::warn("CodeDocument::syntaxTree: Failed to parse document {}!", m_document->fileName());
+        m_parseStatus = CodeDocument::ParseFailed;
+    }
+    // Otherwise the parser would try to resume this parse the next time.
+    parser.reset();
+    m_lineLengths.clear();
+}
+
 std::shared_ptr<treesitter::Query> TreeSitterHelper::constructQuery(const QString &query)
 {
     std::shared_ptr<treesitter::Query> tsQuery;
     try {
-        tsQuery = std::make_shared<treesitter::Query>(parser().language(), query);
+        // Compiled queries are shared between all documents of the same language.
+        tsQuery = treesitter::QueryCache::instance().get(parser().language(), query);
     } catch (treesitter::Query::Error &error) {
         spdlog::error("CodeDocument::constructQuery: Failed to parse query `{}` error: {} at: {}", query,
                       error.description, error.utf8_offset);
@@ -74,47 +321,68 @@ std::shared_ptr<treesitter::Query> TreeSitterHelper::constructQuery(const QStrin
     return tsQuery;
 }
 
-// `nodesInRange` returns only the outermost nodes that fit entirely in the given range.
+// Combine the queries into a single one, so they can be run in a single traversal of the tree.
+std::shared_ptr<treesitter::Query> TreeSitterHelper::constructQuery(const QStringList &queries)
+{
+    std::shared_ptr<treesitter::Query> tsQuery;
+    try {
+        tsQuery = treesitter::QueryCache::instance().get(parser().language(), queries);
+    } catch (treesitter::Query::Error &error) {
+        spdlog::error("CodeDocument::constructQuery: Failed to parse queries `{}` error: {} at: {}",
+                      queries.join('\n'), error.description, error.utf8_offset);
+        return {};
+    }
+    return tsQuery;
+}
+
+// `nodesInRange` returns only the outermost nodes that fit entirely in the given range, in document order.
 // The subsequent children of these outermost nodes are *not* returned, even though
 // they are also technically in the range!
 // This is used by queryInRange to find on which nodes to run the query on.
 QList<treesitter::Node> TreeSitterHelper::nodesInRange(const RangeMark &range)
 {
-    enum RangeComparison { Overlaps, Contains, Disjoint };
-
     const auto &tree = syntaxTree();
 
     if (!tree) {
         return {};
     }
 
-    QList<treesitter::Node> nodesToVisit;
-    QList<treesitter::Node> nodesInRange;
-    nodesToVisit.emplace_back(tree->rootNode());
-
-    auto compareToRange = [&range](const treesitter::Node &node) {
-        if (range.contains(node.startPosition()) && range.contains(node.endPosition() - 1))
-            return RangeComparison::Contains;
-        else if (static_cast<int>(node.startPosition()) <= range.end()
-                 && static_cast<int>(node.endPosition()) >= range.start())
-            return RangeComparison::Overlaps;
-        return RangeComparison::Disjoint;
+    auto contains = [&range](const treesitter::Node &node) {
+        return range.contains(node.startPosition()) && range.contains(node.endPosition() - 1);
     };
 
-    // Note: This could be improved performance-wise using the first_child_for_byte
-    // functions on either TSNode, or TSTreeCursor.
-    // However, these functions aren't currently wrapped and would make the search a bit more complex.
-    while (!nodesToVisit.isEmpty()) {
-        auto node = nodesToVisit.takeLast();
-        switch (compareToRange(node)) {
-        case RangeComparison::Contains:
+    auto root = tree->rootNode();
+    if (contains(root)) {
+        return {root};
+    }
+    if (static_cast<int>(root.startPosition()) > range.end() || static_cast<int>(root.endPosition()) < range.start()) {
+        return {};
+    }
+
+    // Only descend into the nodes overlapping the range, and skip the children before the range directly,
+    // so the cost depends on the size of the range, not on the size of the document.
+    QList<treesitter::Node> nodesInRange;
+    const auto startByte = static_cast<uint32_t>(range.start() * sizeof(QChar));
+    treesitter::TreeCursor cursor(root);
+    bool hasNode = cursor.gotoFirstChildForByte(startByte);
+    while (hasNode) {
+        const auto node = cursor.currentNode();
+        if (static_cast<int>(node.startPosition()) >= range.end()) {
+            // The next siblings are after the range as well.
+            hasNode = false;
+        } else if (contains(node)) {
             nodesInRange.emplace_back(node);
-            break;
-        case RangeComparison::Overlaps:
-            nodesToVisit.append(node.children());
-            break;
-        default:
-            break;
+            hasNode = cursor.gotoNextSibling();
+        } else if (cursor.gotoFirstChildForByte(startByte)) {
+            // The node overlaps the range, continue with its children.
+            continue;
+        } else {
+            hasNode = cursor.gotoNextSibling();
+        }
+
+        // Go back up until there's a next sibling, the cursor can't go above the root node.
+        while (!hasNode && cursor.gotoParent()) {
+            hasNode = cursor.gotoNextSibling();
         }
     }
 
@@ -144,25 +412,63 @@ treesitter::Node TreeSitterHelper::nodeCoveringRange(int start, int end)
     return coveringNode;
 }
 
+QList<Core::Symbol *> TreeSitterHelper::querySymbols()
+{
+    if (symbolQueries.isEmpty())
+        return {};
+
+    const auto queries = kdalgorithms::transformed<QStringList>(symbolQueries, [](const SymbolQuery &symbolQuery) {
+        return symbolQuery.query;
+    });
+    const auto results = m_document->queryMany(constructQuery(queries));
+
+    QList<Core::Symbol *> symbols;
+    for (int i = 0; i < results.size(); ++i) {
+        const auto &toSymbol = symbolQueries.at(i).toSymbol;
+        for (const auto &match : results.at(i)) {
+            symbols.append(toSymbol(m_document, match));
+        }
+    }
+    return symbols;
+}
+
+// The context of a symbol is the list of symbols surrounding it, outermost first.
+// Symbol ranges come from the syntax tree, so they are either nested or disjoint. As the symbols are sorted by
+// start position (outermost first for the same start), a single sweep keeping the chain of surrounding symbols
+// on a stack finds all the contexts.
 void TreeSitterHelper::assignSymbolContexts()
 {
-    auto contextForSymbol = [this](Symbol *symbol) {
-        auto surroundsSymbol = [&symbol](const Symbol *otherSymbol) {
-            return symbol != otherSymbol && otherSymbol->range().contains(symbol->range());
-        };
-        auto surroundingSymbols = kdalgorithms::filtered(m_symbols, surroundsSymbol);
-
-        kdalgorithms::sort_by(
-            surroundingSymbols,
-            [](const auto &symbol) {
-                return symbol->range().length();
-            },
-            kdalgorithms::descending);
-        return surroundingSymbols;
+    struct Surrounding
+    {
+        int index;
+        int start;
+        int end;
     };
+    std::vector<Surrounding> stack;
+    std::vector<QList<Symbol *>> contexts(m_symbols.size());
+
+    for (int i = 0; i < m_symbols.size(); ++i) {
+        const auto range = m_symbols.at(i)->range();
+        const int start = range.start();
+        const int end = range.end();
+
+        while (!stack.empty() && stack.back().end < end)
+            stack.pop_back();
+
+        auto &context = contexts[i];
+        context.reserve(static_cast<qsizetype>(stack.size()));
+        for (const auto &surrounding : stack) {
+            context.append(m_symbols.at(surrounding.index));
+            // Symbols with the same range surround each other.
+            if (surrounding.start == start && surrounding.end == end)
+                contexts[surrounding.index].append(m_symbols.at(i));
+        }
+        stack.push_back({i, start, end});
+    }
 
-    for (const auto &symbol : m_symbols | std::views::reverse) {
-        symbol->assignContext(contextForSymbol(symbol));
+    // Assign from the last symbol to the first one, so the names of the contexts are not qualified yet.
+    for (int i = static_cast<int>(m_symbols.size()) - 1; i >= 0; --i) {
+        m_symbols.at(i)->assignContext(contexts[i]);
     }
 }
 
@@ -173,10 +479,15 @@ const QList<Core::Symbol *> &TreeSitterHelper::symbols()
 
     m_flags |= HasSymbols;
 
-    m_symbols = querySymbols(m_document);
+    m_symbols = querySymbols();
 
-    kdalgorithms::sort_by(m_symbols, [](const auto &symbol) {
-        return symbol->range().start();
+    // Sort by start position, surrounding symbols first, see assignSymbolContexts.
+    std::ranges::stable_sort(m_symbols, [](const Symbol *left, const Symbol *right) {
+        const auto leftRange = left->range();
+        const auto rightRange = right->range();
+        if (leftRange.start() != rightRange.start())
+            return leftRange.start() < rightRange.start();
+        return leftRange.end() > rightRange.end();
     });
 
     assignSymbolContexts();
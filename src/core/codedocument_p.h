@@ -10,7 +10,9 @@
 
 #pragma once
 
+#include "codedocument.h"
 #include "document.h"
+#include "querymatch.h"
 #include "rangemark.h"
 #include "symbol.h"
 #include "treesitter/node.h"
@@ -20,6 +22,8 @@
 
 #include <QList>
 
+#include <atomic>
+
 namespace Core {
 
 class CodeDocument;
@@ -27,27 +31,52 @@ class CodeDocument;
 class TreeSitterHelper
 {
 public:
-    using SymbolQueryFunction = std::function<QList<Core::Symbol *>(CodeDocument *const)>;
-
-    SymbolQueryFunction querySymbols = [](CodeDocument *const) -> QList<Core::Symbol *> {
-        return {};
+    // A query finding symbols, and the function creating a symbol out of each of its matches.
+    struct SymbolQuery
+    {
+        QString query;
+        std::function<Core::Symbol *(CodeDocument *const, const Core::QueryMatch &)> toSymbol;
+
+        // Returns a query creating a symbol of the given kind for each match.
+        static SymbolQuery ofKind(QString query, Symbol::Kind kind)
+        {
+            return {std::move(query), [kind](CodeDocument *const document, const QueryMatch &match) {
+                        return Symbol::makeSymbol(document, match, kind);
+                    }};
+        }
     };
 
+    // All symbol queries are combined, so the symbols are found in a single traversal of the tree.
+    QList<SymbolQuery> symbolQueries;
+
     explicit TreeSitterHelper(CodeDocument *document);
 
     void clear();
+    void edit(int position, int charsRemoved, int charsAdded);
 
     treesitter::Parser &parser();
+    // Returns an empty optional if the document couldn't be parsed, see parseStatus.
     std::optional<treesitter::Tree> &syntaxTree();
 
+    // A failed parse isn't retried until the document is modified, so a pathological file doesn't stall every query.
+    CodeDocument::ParseStatus parseStatus();
+    // Thread-safe, stops the current parse, or the pending one if the document was modified since the last parse.
+    // A cancellation requested while no parse is pending is dropped when the document is modified.
+    void cancelParsing();
+
     std::shared_ptr<treesitter::Query> constructQuery(const QString &query);
+    std::shared_ptr<treesitter::Query> constructQuery(const QStringList &queries);
     QList<treesitter::Node> nodesInRange(const RangeMark &range);
     treesitter::Node nodeCoveringRange(int start, int end);
 
     const QList<Core::Symbol *> &symbols();
 
 private:
+    QList<Core::Symbol *> querySymbols();
     void assignSymbolContexts();
+    void initializeLineLengths();
+    void dropStaleCancellation();
+    void parse();
 
     enum Flags {
         HasSymbols = 0x01,
@@ -56,6 +85,16 @@ private:
     CodeDocument *const m_document;
     std::optional<treesitter::Parser> m_parser;
     std::optional<treesitter::Tree> m_tree;
+    // Previous tree, edited to match the current text, so the next parse can reuse it.
+    std::optional<treesitter::Tree> m_oldTree;
+    // Empty until the document is parsed, reset when the document changes.
+    std::optional<CodeDocument::ParseStatus> m_parseStatus;
+    // Set to non-zero to stop parsing, the parser reads it atomically.
+    alignas(std::atomic_ref<size_t>::required_alignment) size_t m_cancellationFlag = 0;
+    // Length of each line of the text the tree was parsed from (separators excluded).
+    // Needed to compute the end point of the removed text when the document is edited.
+    std::vector<int> m_lineLengths;
+    int m_textLength = 0;
     QList<Core::Symbol *> m_symbols;
     int m_flags = 0;
 };
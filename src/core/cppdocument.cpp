@@ -21,8 +21,6 @@
 #include <QFileInfo>
 #include <QHash>
 #include <QPlainTextEdit>
-#include <QRegularExpression>
-#include <QTextBlock>
 #include <QTextDocument>
 #include <QVariantMap>
 #include <algorithm>
@@ -31,7 +29,7 @@
 namespace {
 using namespace Core;
 
-// We query for classes in queryClassSymbols and queryClassDefinition.
+// We query for classes in symbolQueries and queryClassDefinition.
 // To make sure the results of both are consistent, share the actual query by using this function.
 static QString classQuery(std::optional<QString> className)
 {
@@ -149,7 +147,7 @@ static QString methodDeclarationQuery(const QString &declarator)
         .arg(declarator);
 }
 
-auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+QString functionSymbolsQuery()
 {
     auto functionDeclarator = functionDeclaratorQuery("", std::nullopt);
     auto pointerDeclarator = pointerDeclaratorQuery(functionDeclarator, "@return");
@@ -158,7 +156,7 @@ auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
     auto memberFunctionDeclaration = methodDeclarationQuery(pointerDeclarator);
 
     // clang-format off
-    auto functions = document->query(QString(R"EOF(
+    return QString(R"EOF(
         [; Free function implementations
         %3
 
@@ -177,35 +175,24 @@ auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
 
         ; Member functions
         %4
-    ])EOF").arg(functionDeclarator, pointerDeclarator, functionDefinition, memberFunctionDeclaration));
+    ])EOF").arg(functionDeclarator, pointerDeclarator, functionDefinition, memberFunctionDeclaration);
     // clang-format on
-
-    auto function_to_symbol = [document](const QueryMatch &match) {
-        auto kind = Symbol::Kind::Function;
-        if (!match.get("return").isValid()) {
-            // No return type, this is a Constructor/Destructor
-            // Clangd also assigned the Constructor kind to Destructors, so we'll do the same
-            kind = Symbol::Kind::Constructor;
-        } else if (match.get("name").text().contains("::")) {
-            // This is a bit of a guesstimate, but if the function name contains "::", it's likely a method.
-            // It may also be a member of a namespace, but this information isn't really available unless we try
-            // to resolve the original declaration.
-            kind = Symbol::Kind::Method;
-        }
-        return Symbol::makeSymbol(document, match, kind);
-    };
-
-    return kdalgorithms::transformed<QList<Symbol *>>(functions, function_to_symbol);
 }
 
-auto queryClassSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+Symbol *functionToSymbol(CodeDocument *const document, const QueryMatch &match)
 {
-    auto classesAndStructs = document->query(classQuery(std::nullopt));
-    auto class_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Class);
-    };
-
-    return kdalgorithms::transformed<QList<Symbol *>>(classesAndStructs, class_to_symbol);
+    auto kind = Symbol::Kind::Function;
+    if (!match.get("return").isValid()) {
+        // No return type, this is a Constructor/Destructor
+        // Clangd also assigned the Constructor kind to Destructors, so we'll do the same
+        kind = Symbol::Kind::Constructor;
+    } else if (match.get("name").text().contains("::")) {
+        // This is a bit of a guesstimate, but if the function name contains "::", it's likely a method.
+        // It may also be a member of a namespace, but this information isn't really available unless we try
+        // to resolve the original declaration.
+        kind = Symbol::Kind::Method;
+    }
+    return Symbol::makeSymbol(document, match, kind);
 }
 
 static QString membersQuery(std::optional<QString> name)
@@ -231,43 +218,25 @@ static QString membersQuery(std::optional<QString> name)
     // clang-format on
 }
 
-auto queryMemberSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+QList<TreeSitterHelper::SymbolQuery> symbolQueries()
 {
-    auto members = document->query(membersQuery(std::nullopt));
-
-    auto member_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Field);
-    };
-
-    return kdalgorithms::transformed<QList<Symbol *>>(members, member_to_symbol);
-}
-auto queryEnumSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
-{
-    auto enums = document->query(R"EOF(
+    const auto enumQuery = QString(R"EOF(
         (enum_specifier
           name: (_) @name @selectionRange) @range
     )EOF");
-    auto enum_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Enum);
-    };
-    auto result = kdalgorithms::transformed<QList<Symbol *>>(enums, enum_to_symbol);
-
-    auto enumerators = document->query(R"EOF(
+    const auto enumeratorQuery = QString(R"EOF(
         (enumerator
           name: (_) @name @selectionRange
           value: (_)? @value) @range
     )EOF");
-    result.append(kdalgorithms::transformed<QList<Symbol *>>(enumerators, enum_to_symbol));
 
-    return result;
-}
-auto queryAllSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
-{
-    auto symbols = ::queryClassSymbols(document);
-    symbols.append(::queryFunctionSymbols(document));
-    symbols.append(::queryMemberSymbols(document));
-    symbols.append(::queryEnumSymbols(document));
-    return symbols;
+    return {
+        TreeSitterHelper::SymbolQuery::ofKind(classQuery(std::nullopt), Symbol::Kind::Class),
+        {functionSymbolsQuery(), functionToSymbol},
+        TreeSitterHelper::SymbolQuery::ofKind(membersQuery(std::nullopt), Symbol::Kind::Field),
+        TreeSitterHelper::SymbolQuery::ofKind(enumQuery, Symbol::Kind::Enum),
+        TreeSitterHelper::SymbolQuery::ofKind(enumeratorQuery, Symbol::Kind::Enum),
+    };
 }
 
 }
@@ -290,7 +259,12 @@ CppDocument::CppDocument(QObject *parent)
     : CodeDocument(Type::Cpp, parent)
 {
     // setup symbol query functions specific to c++
-    helper()->querySymbols = ::queryAllSymbols;
+    helper()->symbolQueries = ::symbolQueries();
+
+    m_excludedMacrosHelper = std::make_unique<ExcludedMacrosHelper>(this);
+    connect(this, &TextDocument::contentsChange, this, [this](int position, int charsRemoved, int charsAdded) {
+        m_excludedMacrosHelper->edit(position, charsRemoved, charsAdded);
+    });
 }
 CppDocument::~CppDocument() = default;
 
@@ -322,7 +296,7 @@ void CppDocument::commentSelection()
 {
     LOG("CppDocument::commentSelection");
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.beginEditBlock();
 
     const int cursorPos = cursor.position();
@@ -390,7 +364,7 @@ void CppDocument::commentSelection()
     }
 
     cursor.endEditBlock();
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 static QStringList matchingSuffixes(bool header)
@@ -663,7 +637,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
         return false;
     }
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(symbol->range().end());
     cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor);
     if (cursor.selectedText() != "}") {
@@ -679,7 +653,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
     const QString strTab = tab();
     if (insertAt == StartOfMethod) {
         // Goto the start of the block
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         cursor.setPosition(gotoBlockStart());
         // Move forward one character
         cursor.movePosition(QTextCursor::NextCharacter);
@@ -703,7 +677,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
     cursor.insertText(code);
     cursor.endEditBlock();
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
 
     return true;
 }
@@ -747,7 +721,7 @@ bool CppDocument::insertForwardDeclaration(const QString &forwardDeclaration)
     qualifierList.pop_front();
 
     // Check if the declaration already exists
-    QTextDocument *doc = textEdit()->document();
+    QTextDocument *doc = document();
     QTextCursor cursor(doc);
     cursor = doc->find(result, cursor, QTextDocument::FindWholeWords);
     if (!cursor.isNull()) {
@@ -771,9 +745,9 @@ bool CppDocument::insertForwardDeclaration(const QString &forwardDeclaration)
     }
 
     if (pos != -1) {
-        auto cur = textEdit()->textCursor();
+        auto cur = textCursor();
         cur.setPosition(pos);
-        textEdit()->setTextCursor(cur);
+        setTextCursor(cur);
         cur.beginEditBlock();
         cur.movePosition(QTextCursor::EndOfLine, QTextCursor::MoveAnchor);
         cur.insertText("\n\n" + result);
@@ -989,12 +963,12 @@ int CppDocument::gotoBlockStart(int count)
 {
     LOG_AND_MERGE("CppDocument::gotoBlockStart", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
         --count;
     }
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return cursor.position();
 }
 
@@ -1008,12 +982,12 @@ int CppDocument::gotoBlockEnd(int count)
 {
     LOG_AND_MERGE("CppDocument::gotoBlockEnd", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
         --count;
     }
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return cursor.position();
 }
 
@@ -1027,7 +1001,7 @@ int CppDocument::selectBlockStart(int count)
 {
     LOG_AND_MERGE("CppDocument::selectBlockStart", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     const int selectionStart = std::max(cursor.selectionStart(), cursor.selectionEnd());
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
@@ -1038,7 +1012,7 @@ int CppDocument::selectBlockStart(int count)
     cursor.setPosition(selectionStart, QTextCursor::MoveAnchor);
     cursor.setPosition(blockStartPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockStartPos;
 }
 
@@ -1052,7 +1026,7 @@ int CppDocument::selectBlockEnd(int count)
 {
     LOG_AND_MERGE("CppDocument::selectBlockEnd", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     const int selectionStart = std::min(cursor.selectionStart(), cursor.selectionEnd());
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
@@ -1063,7 +1037,7 @@ int CppDocument::selectBlockEnd(int count)
     cursor.setPosition(selectionStart, QTextCursor::MoveAnchor);
     cursor.setPosition(blockEndPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockEndPos;
 }
 
@@ -1077,7 +1051,7 @@ int CppDocument::selectBlockUp(int count)
 {
     LOG_AND_MERGE("CppDocument::selectBlockUp", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
         --count;
@@ -1087,7 +1061,7 @@ int CppDocument::selectBlockUp(int count)
     cursor.setPosition(blockStartPos, QTextCursor::MoveAnchor);
     cursor.setPosition(blockEndPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockEndPos;
 }
 
@@ -1101,11 +1075,11 @@ int CppDocument::moveBlock(int startPos, QTextCursor::MoveOperation direction)
 {
     Q_ASSERT(direction == QTextCursor::NextCharacter || direction == QTextCursor::PreviousCharacter);
 
-    QTextDocument *doc = textEdit()->document();
+    QTextDocument *doc = document();
     Q_ASSERT(doc);
 
     const int inc = direction == QTextCursor::NextCharacter ? 1 : -1;
-    const int lastPos = direction == QTextCursor::NextCharacter ? textEdit()->document()->characterCount() - 1 : 0;
+    const int lastPos = direction == QTextCursor::NextCharacter ? document()->characterCount() - 1 : 0;
     if (startPos == lastPos)
         return startPos;
     int pos = startPos + inc;
@@ -1174,7 +1148,7 @@ void CppDocument::toggleSection()
     const auto elseString = QStringLiteral("#else // ") + sectionSettings.tag;
     const auto newLine = QStringLiteral("\n");
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     if (cursor.hasSelection()) {
         // If there's a selection, just add #ifdef/#endif
         cursor.beginEditBlock();
@@ -1188,7 +1162,7 @@ void CppDocument::toggleSection()
         cursor.insertText(ifdefString + newLine);
         // Move after the #endif
         cursor.endEditBlock();
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         gotoLine(line + 3);
 
     } else {
@@ -1210,7 +1184,7 @@ void CppDocument::toggleSection()
 
         if (cursor.selectedText().startsWith(endifString)) {
             // The function is already commented out, remove the comments
-            int start = textEdit()->document()->find(elseString, cursor, QTextDocument::FindBackward).selectionStart();
+            int start = document()->find(elseString, cursor, QTextDocument::FindBackward).selectionStart();
             if (start > symbol->range().start())
                 cursor.setPosition(start, QTextCursor::KeepAnchor);
             cursor.removeSelectedText();
@@ -1247,7 +1221,7 @@ void CppDocument::toggleSection()
             cursorPos += ifdefString.length() + 1;
         }
         cursor.endEditBlock();
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         setPosition(cursorPos);
     }
 }
@@ -1415,9 +1389,9 @@ bool CppDocument::addMethodDefinition(const QString &method, const QString &clas
 
     QString indent = "\n\n";
 
-    auto lastBracePos = textEdit()->toPlainText().lastIndexOf('}');
+    auto lastBracePos = document()->toPlainText().lastIndexOf('}');
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.beginEditBlock();
 
     cursor.setPosition(lastBracePos + 1);
@@ -1425,11 +1399,11 @@ bool CppDocument::addMethodDefinition(const QString &method, const QString &clas
 
     // Add the method definition
     cursor.insertText(indent + methodDef);
-    auto methodStartPos = textEdit()->toPlainText().lastIndexOf('{');
+    auto methodStartPos = document()->toPlainText().lastIndexOf('{');
     cursor.setPosition(methodStartPos + 1); // move to position after opening brace
     cursor.endEditBlock();
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return true;
 }
 
@@ -1750,73 +1724,7 @@ QStringList CppDocument::primitiveTypes() const
 
 QList<treesitter::Range> CppDocument::includedRanges() const
 {
-    auto macros = Settings::instance()->value<QStringList>(Settings::CppExcludedMacros);
-    if (macros.isEmpty()) {
-        return {};
-    }
-
-    QRegularExpression regex(macros.join("|"));
-    if (!regex.isValid()) {
-        spdlog::error("CppDocument::includedRanges: Failed to create regex for excluded macros: {}",
-                      regex.errorString());
-        return {};
-    }
-
-    auto document = textEdit()->document();
-
-    QList<treesitter::Range> ranges;
-    treesitter::Point lastPoint {0, 0};
-    uint32_t lastByte = 0;
-
-    for (auto block = document->firstBlock(); block.isValid(); block = block.next()) {
-        QRegularExpressionMatch match;
-        auto searchFrom = 0;
-        auto index = block.text().indexOf(regex, searchFrom, &match);
-
-        // Run this in a loop to support multiple macros on the same line.
-        while (index != -1) {
-            // We need to construct a range from the end of the last match to the start of the current match.
-            //
-            // Note that the ranges have an inclusive start and an exclusive end..
-            //
-            // Also Note that the column seems to be in bytes, not characters.
-            // This is why we multiply by sizeof(QChar) to get the correct column.
-            // At least that's what the TreeSitterInspector shows us.
-            auto endPoint = treesitter::Point {.row = static_cast<uint32_t>(block.blockNumber()),
-                                               .column = static_cast<uint32_t>(index * sizeof(QChar))};
-            ranges.push_back({.start_point = lastPoint,
-                              .end_point = endPoint,
-                              .start_byte = lastByte,
-                              // No need to add - 1 here, the ranges are exclusive at the end.
-                              .end_byte = static_cast<uint32_t>((block.position() + index) * sizeof(QChar))});
-
-            auto matchLength = match.capturedLength();
-            lastByte = static_cast<uint32_t>((block.position() + index + matchLength) * sizeof(QChar));
-            lastPoint = {.row = static_cast<uint32_t>(block.blockNumber()),
-                         .column = static_cast<uint32_t>((index + matchLength) * sizeof(QChar))};
-            if (lastPoint.column == static_cast<uint32_t>(block.length())) {
-                ++lastPoint.row;
-                lastPoint.column = 0;
-            }
-
-            searchFrom = index + matchLength;
-            index = block.text().indexOf(regex, searchFrom, &match);
-        }
-    }
-
-    if (!ranges.isEmpty()) {
-        // Add the last range, up to the end of the document, but only if we have another range.
-        // Leaving the ranges empty will parse the entire document, so that's easiest.
-        auto endPoint =
-            treesitter::Point {.row = static_cast<uint32_t>(document->blockCount() - 1),
-                               .column = static_cast<uint32_t>(document->lastBlock().length() * sizeof(QChar))};
-        ranges.push_back({.start_point = lastPoint,
-                          .end_point = endPoint,
-                          .start_byte = lastByte,
-                          .end_byte = static_cast<uint32_t>(document->characterCount() * sizeof(QChar))});
-    }
-
-    return ranges;
+    return m_excludedMacrosHelper->includedRanges();
 }
 
 } // namespace Core
@@ -21,6 +21,8 @@
 
 namespace Core {
 
+class ExcludedMacrosHelper;
+
 class CppDocument : public CodeDocument
 {
     Q_OBJECT
@@ -115,6 +117,7 @@ private:
     void changeBaseClassForwardInclude(const QString &originalClassBaseName, const QString &newClassBaseName);
 
     friend class IncludeHelper;
+    std::unique_ptr<ExcludedMacrosHelper> m_excludedMacrosHelper;
 };
 
 } // namespace Core
@@ -10,6 +10,13 @@
 
 #include "cppdocument_p.h"
 #include "cppdocument.h"
+#include "settings.h"
+#include "utils/log.h"
+
+#include <QPlainTextEdit>
+#include <QRegularExpression>
+#include <QTextBlock>
+#include <QTextDocument>
 
 namespace Core {
 
@@ -160,4 +167,157 @@ void IncludeHelper::computeIncludes()
         processGroup(group);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// ExcludedMacrosHelper
+//////////////////////////////////////////////////////////////////////////////
+namespace {
+
+// The regex is shared by all documents, and only compiled again when the excluded macros change.
+struct ExcludedMacrosRegex
+{
+    int revision = -1;
+    QStringList macros;
+    QRegularExpression regex;
+    // Incremented each time the regex changes, so documents know their matches are outdated.
+    int generation = 0;
+};
+
+// Returns nullptr if there are no excluded macros, or if the regex is invalid.
+const ExcludedMacrosRegex *excludedMacrosRegex()
+{
+    static ExcludedMacrosRegex cache;
+
+    auto settings = Settings::instance();
+    if (cache.revision != settings->revision()) {
+        cache.revision = settings->revision();
+        auto macros = settings->value<QStringList>(Settings::CppExcludedMacros);
+        if (macros != cache.macros || cache.generation == 0) {
+            cache.macros = macros;
+            cache.regex = QRegularExpression(macros.join("|"));
+            cache.regex.optimize();
+            ++cache.generation;
+            if (!macros.isEmpty() && !cache.regex.isValid()) {
+                spdlog::error("CppDocument::includedRanges: Failed to create regex for excluded macros: {}",
+                              cache.regex.errorString());
+            }
+        }
+    }
+
+    if (cache.macros.isEmpty() || !cache.regex.isValid())
+        return nullptr;
+    return &cache;
+}
+
+} // namespace
+
+ExcludedMacrosHelper::ExcludedMacrosHelper(CppDocument *document)
+    : m_document(document)
+{
+}
+
+void ExcludedMacrosHelper::edit(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    if (m_blocks.empty())
+        return;
+
+    // The document is already modified, so the block count tells how many blocks were removed or added.
+    auto document = m_document->document();
+    const auto delta = document->blockCount() - static_cast<int>(m_blocks.size());
+    const auto startRow = document->findBlock(position).blockNumber();
+    const auto newEndRow = document->findBlock(position + charsAdded).blockNumber();
+    const auto oldEndRow = newEndRow - delta;
+
+    if (startRow < 0 || newEndRow < startRow || oldEndRow < startRow
+        || oldEndRow >= static_cast<int>(m_blocks.size())) {
+        invalidate();
+        return;
+    }
+
+    m_blocks.erase(m_blocks.begin() + startRow, m_blocks.begin() + oldEndRow + 1);
+    m_blocks.insert(m_blocks.begin() + startRow, newEndRow - startRow + 1, BlockMatches {});
+}
+
+void ExcludedMacrosHelper::invalidate()
+{
+    m_blocks.clear();
+}
+
+QList<treesitter::Range> ExcludedMacrosHelper::includedRanges()
+{
+    auto regex = excludedMacrosRegex();
+    if (!regex) {
+        invalidate();
+        return {};
+    }
+
+    auto document = m_document->document();
+    if (regex->generation != m_regexGeneration || static_cast<int>(m_blocks.size()) != document->blockCount()) {
+        m_regexGeneration = regex->generation;
+        m_blocks.assign(document->blockCount(), BlockMatches {});
+    }
+
+    QList<treesitter::Range> ranges;
+    treesitter::Point lastPoint {0, 0};
+    uint32_t lastByte = 0;
+
+    auto block = document->firstBlock();
+    for (auto &blockMatches : m_blocks) {
+        Q_ASSERT(block.isValid());
+        // Only the blocks changed since the last call are scanned again.
+        if (!blockMatches) {
+            blockMatches = QList<Match> {};
+            const auto text = block.text();
+            QRegularExpressionMatch match;
+            auto index = text.indexOf(regex->regex, 0, &match);
+            // Run this in a loop to support multiple macros on the same line.
+            while (index != -1) {
+                const auto length = static_cast<int>(match.capturedLength());
+                blockMatches->push_back({index, length});
+                index = text.indexOf(regex->regex, index + length, &match);
+            }
+        }
+
+        for (const auto &match : std::as_const(*blockMatches)) {
+            // We need to construct a range from the end of the last match to the start of the current match.
+            //
+            // Note that the ranges have an inclusive start and an exclusive end..
+            //
+            // Also Note that the column seems to be in bytes, not characters.
+            // This is why we multiply by sizeof(QChar) to get the correct column.
+            // At least that's what the TreeSitterInspector shows us.
+            auto endPoint = treesitter::Point {.row = static_cast<uint32_t>(block.blockNumber()),
+                                               .column = static_cast<uint32_t>(match.index * sizeof(QChar))};
+            ranges.push_back({.start_point = lastPoint,
+                              .end_point = endPoint,
+                              .start_byte = lastByte,
+                              // No need to add - 1 here, the ranges are exclusive at the end.
+                              .end_byte = static_cast<uint32_t>((block.position() + match.index) * sizeof(QChar))});
+
+            lastByte = static_cast<uint32_t>((block.position() + match.index + match.length) * sizeof(QChar));
+            lastPoint = {.row = static_cast<uint32_t>(block.blockNumber()),
+                         .column = static_cast<uint32_t>((match.index + match.length) * sizeof(QChar))};
+            if (lastPoint.column == static_cast<uint32_t>(block.length())) {
+                ++lastPoint.row;
+                lastPoint.column = 0;
+            }
+        }
+        block = block.next();
+    }
+
+    if (!ranges.isEmpty()) {
+        // Add the last range, up to the end of the document, but only if we have another range.
+        // Leaving the ranges empty will parse the entire document, so that's easiest.
+        auto endPoint =
+            treesitter::Point {.row = static_cast<uint32_t>(document->blockCount() - 1),
+                               .column = static_cast<uint32_t>(document->lastBlock().length() * sizeof(QChar))};
+        ranges.push_back({.start_point = lastPoint,
+                          .end_point = endPoint,
+                          .start_byte = lastByte,
+                          .end_byte = static_cast<uint32_t>(document->characterCount() * sizeof(QChar))});
+    }
+
+    return ranges;
+}
+
 }
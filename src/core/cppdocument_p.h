@@ -10,8 +10,11 @@
 
 #pragma once
 
+#include "treesitter/parser.h"
 #include "utils/json.h"
 
+#include <QList>
+
 #include <map>
 #include <optional>
 #include <vector>
@@ -134,4 +137,38 @@ private:
     IncludeGroups m_includeGroups;
 };
 
+/**
+ * Keeps track of the excluded macros (see Settings::CppExcludedMacros) found in a document.
+ *
+ * The matches are stored per block, and only the blocks touched by an edit are scanned again when the included ranges
+ * are requested, so an incremental reparse doesn't need to go through the whole document.
+ */
+class ExcludedMacrosHelper
+{
+public:
+    explicit ExcludedMacrosHelper(CppDocument *document);
+
+    /**
+     * Marks the blocks touched by a change as dirty, the arguments are the ones of TextDocument::contentsChange.
+     */
+    void edit(int position, int charsRemoved, int charsAdded);
+
+    QList<treesitter::Range> includedRanges();
+
+private:
+    struct Match
+    {
+        int index;
+        int length;
+    };
+    // An empty optional means the block needs to be scanned again.
+    using BlockMatches = std::optional<QList<Match>>;
+
+    void invalidate();
+
+    CppDocument *const m_document;
+    std::vector<BlockMatches> m_blocks;
+    int m_regexGeneration = -1;
+};
+
 } // namespace Core
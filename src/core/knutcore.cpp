@@ -9,9 +9,11 @@
 */
 
 #include "knutcore.h"
+#include "profiler.h"
 #include "project.h"
 #include "scriptmanager.h"
 #include "textdocument.h"
+#include "tracer.h"
 
 #include <QAbstractItemModel>
 #include <QApplication>
@@ -92,6 +94,27 @@ bool KnutCore::process(const QStringList &arguments)
 
     initialize(mode);
 
+    // Trace the API calls, the trace is saved when Knut exits
+    const QString traceFileName = parser.value("trace");
+    if (!traceFileName.isEmpty()) {
+        Tracer::start();
+        connect(Project::instance(), &Project::currentDocumentChanged, this, [](Core::Document *document) {
+            Tracer::setDocumentName(document ? document->fileName() : QString());
+        });
+        connect(qApp, &QCoreApplication::aboutToQuit, this, [traceFileName]() {
+            Tracer::stop();
+            Tracer::save(traceFileName);
+        });
+    }
+
+    // Profile the API calls, the report is printed when Knut exits
+    if (parser.isSet("profile")) {
+        Profiler::start();
+        connect(qApp, &QCoreApplication::aboutToQuit, this, []() {
+            std::cout << Profiler::report().toStdString() << "\n";
+        });
+    }
+
     const QStringList positionalArguments = parser.positionalArguments();
     // Set the root directory
     if (!positionalArguments.isEmpty()) {
@@ -174,7 +197,9 @@ void KnutCore::initParser(QCommandLineParser &parser) const
                        {{"c", "column"}, "Column in the current file, if any.", "column"},
                        {{"d", "data"}, "JSON data string for initializing the dialog.", "data"},
                        {"json-list", "Returns the list of all available scripts as a JSON file"},
-                       {"json-settings", "Returns the settings as a JSON file"}});
+                       {"json-settings", "Returns the settings as a JSON file"},
+                       {"profile", "Prints the time spent in the API calls, per API, script function and document."},
+                       {"trace", "Saves a trace of the API calls in <file>, in the Chrome trace format.", "file"}});
 }
 
 void KnutCore::doParse(const QCommandLineParser &parser) const
@@ -190,6 +215,9 @@ void KnutCore::initialize(Settings::Mode mode)
         return;
     new Settings(mode, this);
     new Project(this);
+    connect(Project::instance(), &Project::currentDocumentChanged, this, [](Core::Document *document) {
+        Profiler::setDocumentName(document ? document->fileName() : QString());
+    });
     new ScriptManager(this);
     if (Core::Settings::instance()->value<bool>(Core::Settings::SaveLogsToFile))
         initializeMultiSinkLogger();
@@ -0,0 +1,141 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "lineindex_p.h"
+
+#include <QTextBlock>
+#include <QTextDocument>
+
+namespace Core {
+
+LineIndex::LineIndex(const QTextDocument *document)
+    : m_document(document)
+{
+}
+
+void LineIndex::update(int from, int charsRemoved, int charsAdded)
+{
+    if (m_before.empty() && m_after.empty())
+        return;
+
+    // The lines after the split are the ones removed or shifted by the change.
+    moveSplit(upperBound(from));
+
+    // The lines starting in the removed text are gone, the ones after are shifted all at once.
+    while (!m_after.empty() && m_after.back() + m_afterShift <= from + charsRemoved)
+        m_after.pop_back();
+    m_afterShift += charsAdded - charsRemoved;
+    if (m_after.empty())
+        m_afterShift = 0;
+
+    // The lines starting in the added text are read from the document.
+    for (auto block = m_document->findBlock(from).next(); block.isValid() && block.position() <= from + charsAdded;
+         block = block.next()) {
+        m_before.push_back(block.position());
+    }
+
+    // QTextDocument may report a change larger than the document (when clearing it for example)
+    if (static_cast<int>(m_before.size() + m_after.size()) != m_document->blockCount())
+        invalidate();
+}
+
+void LineIndex::invalidate()
+{
+    m_before.clear();
+    m_after.clear();
+    m_afterShift = 0;
+}
+
+int LineIndex::lineCount() const
+{
+    ensureBuilt();
+    return static_cast<int>(m_before.size() + m_after.size());
+}
+
+int LineIndex::lineStart(int line) const
+{
+    if (line < 0 || line >= lineCount())
+        return -1;
+    return start(line);
+}
+
+int LineIndex::lineEnd(int line) const
+{
+    if (line < 0 || line >= lineCount())
+        return -1;
+    if (line + 1 == lineCount())
+        return m_document->characterCount() - 1;
+    return start(line + 1) - 1;
+}
+
+int LineIndex::lineAt(int position, int hint) const
+{
+    if (position < 0 || position >= m_document->characterCount())
+        return -1;
+
+    const int count = lineCount();
+    auto isInLine = [&](int line) {
+        return line >= 0 && line < count && start(line) <= position && (line + 1 == count || position < start(line + 1));
+    };
+    if (isInLine(hint))
+        return hint;
+    if (isInLine(hint + 1))
+        return hint + 1;
+
+    return upperBound(position) - 1;
+}
+
+void LineIndex::ensureBuilt() const
+{
+    if (m_before.empty() && m_after.empty()) {
+        m_before.reserve(m_document->blockCount());
+        for (auto block = m_document->begin(); block.isValid(); block = block.next())
+            m_before.push_back(block.position());
+        m_afterShift = 0;
+    }
+}
+
+int LineIndex::start(int line) const
+{
+    const int beforeCount = static_cast<int>(m_before.size());
+    if (line < beforeCount)
+        return m_before[line];
+    return m_after[m_after.size() - 1 - (line - beforeCount)] + m_afterShift;
+}
+
+int LineIndex::upperBound(int position) const
+{
+    int first = 0;
+    int count = lineCount();
+    while (count > 0) {
+        const int step = count / 2;
+        if (start(first + step) <= position) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+void LineIndex::moveSplit(int line)
+{
+    while (static_cast<int>(m_before.size()) > line) {
+        m_after.push_back(m_before.back() - m_afterShift);
+        m_before.pop_back();
+    }
+    while (static_cast<int>(m_before.size()) < line) {
+        m_before.push_back(m_after.back() + m_afterShift);
+        m_after.pop_back();
+    }
+}
+
+} // namespace Core
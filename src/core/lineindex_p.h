@@ -0,0 +1,67 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <vector>
+
+class QTextDocument;
+
+namespace Core {
+
+/**
+ * Keeps the start position of every line of a QTextDocument, to convert positions to lines and back.
+ *
+ * Finding a line is then a binary search, instead of walking the blocks of the document. The index is updated on each
+ * change of the document: only the lines inside the change are looked up again in the document. The lines after it
+ * are not shifted one by one: the line starts are split in two at the last change, like a gap buffer, and the lines
+ * after the split share one shift. An update then only costs the number of lines between two consecutive changes,
+ * which is small when editing a document in order. It's built lazily, the first time it's needed.
+ *
+ * Lines and columns are 0-based here.
+ */
+class LineIndex
+{
+public:
+    explicit LineIndex(const QTextDocument *document);
+
+    // Must be called for every change of the document, with the arguments of QTextDocument::contentsChange.
+    void update(int from, int charsRemoved, int charsAdded);
+    // Must be called if the document is changed without QTextDocument::contentsChange being emitted.
+    void invalidate();
+
+    int lineCount() const;
+    // Returns the start position of the line, or -1 if the line doesn't exist.
+    int lineStart(int line) const;
+    // Returns the end position of the line, before the line break.
+    int lineEnd(int line) const;
+    // Returns the line of the position, or -1 if the position is outside the document.
+    // `hint` is a line to check first, to avoid the search when converting positions in order.
+    int lineAt(int position, int hint = -1) const;
+
+private:
+    void ensureBuilt() const;
+    // Returns the start position of the line, without checking it exists.
+    int start(int line) const;
+    // Returns the first line starting after the position.
+    int upperBound(int position) const;
+    // Moves the split so `line` is the first line after it.
+    void moveSplit(int line);
+
+    const QTextDocument *m_document;
+    // Both vectors are empty if the index needs to be rebuilt.
+    // Lines before the split, in order.
+    mutable std::vector<int> m_before;
+    // Lines after the split, in reverse order (the line just after the split is the last one) and without m_afterShift.
+    mutable std::vector<int> m_after;
+    mutable int m_afterShift = 0;
+};
+
+} // namespace Core
@@ -17,27 +17,37 @@
 
 namespace Core {
 
-LoggerObject::LoggerObject()
-    : m_firstLogger(m_canLog)
-{
-}
-
 LoggerObject::~LoggerObject()
 {
+    if (m_traceEvent != -1)
+        Tracer::endEvent(m_traceEvent);
+    if (m_profiled)
+        Profiler::endCall();
     if (m_firstLogger)
         m_canLog = true;
+    --m_callDepth;
 }
 
-void LoggerObject::log(QString &&string)
-{
-    spdlog::trace(string);
-    m_canLog = false;
-}
+// Returned strings larger than that are only kept as a hash
+static constexpr qsizetype LargeStringSize = 1024;
 
 HistoryModel::HistoryModel(QObject *parent)
     : QAbstractTableModel(parent)
 {
     LoggerObject::m_model = this;
+
+    auto settings = Settings::instance();
+    auto updateMaxMemory = [this, settings]() {
+        m_maxMemory = qsizetype(settings->value<int>(Settings::HistoryMaxMemory)) * 1024 * 1024;
+        removeOldData();
+    };
+    updateMaxMemory();
+    // Loading a project may change the limit
+    connect(settings, &Settings::settingsLoaded, this, updateMaxMemory);
+    connect(settings, &Settings::settingsChanged, this, [updateMaxMemory](const QString &path) {
+        if (path == Settings::HistoryMaxMemory)
+            updateMaxMemory();
+    });
 }
 
 HistoryModel::~HistoryModel()
@@ -59,6 +69,21 @@ int HistoryModel::columnCount(const QModelIndex &parent) const
 
 static QString variantToString(const QVariant &variant)
 {
+    // Lists and maps are written as javascript arrays and objects
+    if (static_cast<QMetaType::Type>(variant.typeId()) == QMetaType::QStringList) {
+        QStringList items;
+        for (const auto &item : variant.toStringList())
+            items.push_back(variantToString(item));
+        return '[' + items.join(", ") + ']';
+    }
+    if (static_cast<QMetaType::Type>(variant.typeId()) == QMetaType::QVariantMap) {
+        const auto map = variant.toMap();
+        QStringList items;
+        for (auto it = map.cbegin(); it != map.cend(); ++it)
+            items.push_back(variantToString(it.key()) + ": " + variantToString(it.value()));
+        return '{' + items.join(", ") + '}';
+    }
+
     QString text = variant.toString();
     if (static_cast<QMetaType::Type>(variant.typeId()) == QMetaType::QString) {
         text.replace('\\', R"(\\)");
@@ -118,6 +143,8 @@ void HistoryModel::clear()
 {
     beginResetModel();
     m_data.clear();
+    m_names.clear();
+    m_memory = 0;
     endResetModel();
 }
 
@@ -159,7 +186,8 @@ QString HistoryModel::createScript(int start, int end)
         // Pass the parameters
         QStringList paramStrings;
         for (const auto &param : data.params) {
-            if (!param.name.isEmpty() && returnVariables.value(param.name) == param.value) {
+            if (!param.name.isEmpty() && returnVariables.contains(param.name)
+                && isSameValue(returnVariables.value(param.name), param.value)) {
                 paramStrings.append(param.name);
                 continue;
             }
@@ -191,15 +219,17 @@ QString HistoryModel::createScript(const QModelIndex &startIndex, const QModelIn
 
 void HistoryModel::logData(const QString &name)
 {
-    addData(LogData {name, {}, {}}, false);
+    addData(LogData {internedName(name), {}, {}}, false);
 }
 
 void HistoryModel::addData(LogData &&data, bool merge)
 {
     if (!merge || m_data.empty() || m_data.back().name != data.name) {
+        updateMemory(data);
         beginInsertRows({}, static_cast<int>(m_data.size()), static_cast<int>(m_data.size()));
         m_data.push_back(std::move(data));
         endInsertRows();
+        removeOldData();
         return;
     }
 
@@ -222,8 +252,96 @@ void HistoryModel::addData(LogData &&data, bool merge)
             Q_UNREACHABLE();
         }
     }
+    updateMemory(lastData);
     auto lastIndex = index(static_cast<int>(m_data.size()) - 1, ParamCol);
     emit dataChanged(lastIndex, lastIndex);
+    removeOldData();
+}
+
+void HistoryModel::setReturnArg(QString &&name, QVariant &&value)
+{
+    auto &lastData = m_data.back();
+    lastData.returnArg.name = internedName(name);
+    lastData.returnArg.value = std::move(value);
+    updateMemory(lastData);
+    removeOldData();
+}
+
+QVariant HistoryModel::returnedString(const QString &value)
+{
+    if (value.size() < LargeStringSize)
+        return value;
+    return QVariant::fromValue(StringDigest {qHash(value), value.size()});
+}
+
+bool HistoryModel::isSameValue(const QVariant &returnValue, const QVariant &paramValue)
+{
+    if (returnValue.metaType() == QMetaType::fromType<StringDigest>()) {
+        if (static_cast<QMetaType::Type>(paramValue.typeId()) != QMetaType::QString)
+            return false;
+        const auto text = paramValue.toString();
+        return returnValue.value<StringDigest>() == StringDigest {qHash(text), text.size()};
+    }
+    return returnValue == paramValue;
+}
+
+QString HistoryModel::internedName(const QString &name)
+{
+    auto it = m_names.constFind(name);
+    if (it == m_names.cend())
+        it = m_names.insert(name);
+    return *it;
+}
+
+static qsizetype variantMemory(const QVariant &value)
+{
+    switch (static_cast<QMetaType::Type>(value.typeId())) {
+    case QMetaType::QString:
+        return value.toString().size() * qsizetype(sizeof(QChar));
+    case QMetaType::QStringList: {
+        qsizetype memory = 0;
+        for (const auto &text : value.toStringList())
+            memory += text.size() * qsizetype(sizeof(QChar));
+        return memory;
+    }
+    case QMetaType::QVariantMap: {
+        const auto map = value.toMap();
+        qsizetype memory = 0;
+        for (auto it = map.cbegin(); it != map.cend(); ++it)
+            memory += it.key().size() * qsizetype(sizeof(QChar)) + variantMemory(it.value());
+        return memory;
+    }
+    default:
+        return 0;
+    }
+}
+
+void HistoryModel::updateMemory(LogData &data)
+{
+    // Names are shared between all calls, they are not counted
+    qsizetype memory = sizeof(LogData) + variantMemory(data.returnArg.value);
+    for (const auto &param : data.params)
+        memory += sizeof(Arg) + variantMemory(param.value);
+    m_memory += memory - data.memory;
+    data.memory = memory;
+}
+
+// Removes the oldest calls until the memory used fits in the limit, the last call is always kept.
+void HistoryModel::removeOldData()
+{
+    if (m_maxMemory <= 0 || m_memory <= m_maxMemory || m_data.size() <= 1)
+        return;
+
+    int count = 0;
+    qsizetype memory = m_memory;
+    while (memory > m_maxMemory && count + 1 < static_cast<int>(m_data.size())) {
+        memory -= m_data[count].memory;
+        ++count;
+    }
+    beginRemoveRows({}, 0, count - 1);
+    m_data.erase(m_data.begin(), m_data.begin() + count);
+    m_memory = memory;
+    endRemoveRows();
 }
 
 LoggerDisabler::LoggerDisabler(bool silenceAll)
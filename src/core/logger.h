@@ -10,15 +10,20 @@
 
 #pragma once
 
+#include "profiler.h"
 #include "scriptdialogitem.h"
+#include "tracer.h"
 #include "utils/log.h"
 
 #include <QAbstractItemModel>
 #include <QCoreApplication>
 #include <QMetaEnum>
+#include <QSet>
 #include <QString>
 #include <QVariantList>
+#include <QVariantMap>
 #include <concepts>
+#include <deque>
 #include <vector>
 
 /**
@@ -28,14 +33,21 @@
 
 /**
  * Log a method, with all its parameters.
+ * The parameters are only evaluated if the call is logged somewhere, otherwise it's a simple check.
  */
-#define LOG(name, ...) Core::LoggerObject __loggerObject(name, false, ##__VA_ARGS__)
+#define LOG(name, ...)                                                                                                 \
+    Core::LoggerObject __loggerObject(name, [&](Core::LoggerObject &__logger) {                                       \
+        __logger.log(name, false, ##__VA_ARGS__);                                                                      \
+    })
 
 /**
  * Log a method, with all its parameters. If the previous log is also the same method, it will be merged into one
  * operation
  */
-#define LOG_AND_MERGE(name, ...) Core::LoggerObject __loggerObject(name, true, ##__VA_ARGS__)
+#define LOG_AND_MERGE(name, ...)                                                                                       \
+    Core::LoggerObject __loggerObject(name, [&](Core::LoggerObject &__logger) {                                       \
+        __logger.log(name, true, ##__VA_ARGS__);                                                                       \
+    })
 
 /**
  * Macro to save the returned value in the historymodel
@@ -43,7 +55,8 @@
 #define LOG_RETURN(name, value)                                                                                        \
     do {                                                                                                               \
         const auto &__value = value;                                                                                   \
-        __loggerObject.setReturnValue(name, __value);                                                                  \
+        if (__loggerObject.hasHistory())                                                                               \
+            __loggerObject.setReturnValue(name, __value);                                                              \
         return __value;                                                                                                \
     } while (false)
 
@@ -91,6 +104,12 @@ QString valueToString(const T &data)
         return QString::number(data);
     else if constexpr (std::is_same_v<std::remove_cvref_t<T>, QStringList>)
         return '{' + data.join(", ") + '}';
+    else if constexpr (std::is_same_v<std::remove_cvref_t<T>, QVariantMap>) {
+        QStringList items;
+        for (auto it = data.cbegin(); it != data.cend(); ++it)
+            items.push_back(it.key() + ": " + valueToString(it.value().toString()));
+        return '{' + items.join(", ") + '}';
+    }
     else if constexpr (std::is_enum_v<T>) {
         const auto metaEnum = QMetaEnum::fromType<T>();
         QString className = QMetaType::fromType<T>().metaObject()->className();
@@ -109,6 +128,21 @@ QString valueToString(const T &data)
 struct LoggerArgBase
 {
 };
+
+/**
+ * @brief Returns a string for a parameter, only using the first `maxSize` characters of strings
+ * A negative `maxSize` formats the whole value.
+ */
+template <class T>
+QString truncatedValueToString(const T &data, qsizetype maxSize)
+{
+    if constexpr (std::derived_from<T, LoggerArgBase>)
+        return truncatedValueToString(data.value, maxSize);
+    else if constexpr (std::is_same_v<std::remove_cvref_t<T>, QString>)
+        return valueToString(data.left(maxSize));
+    else
+        return valueToString(data).left(maxSize);
+}
 /**
  * @brief Argument for a call
  * The argName will be matched to an existing returned value from a previous method, when recording a script.
@@ -127,6 +161,13 @@ struct LoggerArg : public LoggerArgBase
     QString toString() const { return valueToString(value); }
 };
 
+/**
+ * @brief Model storing the API calls done, used to create scripts
+ *
+ * The history only keeps the last calls, up to the `/logs/historyMaxMemory` setting (in MB, 0 for no limit): the
+ * oldest calls are removed once the limit is reached. To save memory, names are shared between all calls, and large
+ * strings returned by a call are only kept as a hash, enough to know if they are passed to a later call.
+ */
 class HistoryModel : public QAbstractTableModel
 {
     Q_OBJECT
@@ -165,6 +206,15 @@ private:
         QString name;
         std::vector<Arg> params;
         Arg returnArg;
+        // Estimated memory used by the call
+        qsizetype memory = 0;
+    };
+    // Stored instead of a large returned string
+    struct StringDigest
+    {
+        size_t hash = 0;
+        qsizetype size = 0;
+        bool operator==(const StringDigest &other) const = default;
     };
 
     void logData(const QString &name);
@@ -172,7 +222,7 @@ private:
     void logData(const QString &name, bool merge, Ts... params)
     {
         LogData data;
-        data.name = name;
+        data.name = internedName(name);
         fillLogData(data, params...);
         addData(std::move(data), merge);
     }
@@ -180,8 +230,10 @@ private:
     template <typename T>
     void setReturnValue(QString &&name, const T &value)
     {
-        m_data.back().returnArg.name = std::move(name);
-        m_data.back().returnArg.value = QVariant::fromValue(value);
+        if constexpr (std::is_same_v<T, QString>)
+            setReturnArg(std::move(name), returnedString(value));
+        else
+            setReturnArg(std::move(name), QVariant::fromValue(value));
     }
 
     void fillLogData(LogData &) { }
@@ -190,7 +242,7 @@ private:
     void fillLogData(LogData &data, T param, Ts... params)
     {
         if constexpr (std::derived_from<T, LoggerArgBase>)
-            data.params.push_back({param.argName, QVariant::fromValue(param.value)});
+            data.params.push_back({internedName(param.argName), QVariant::fromValue(param.value)});
         else
             data.params.push_back({"", QVariant::fromValue(param)});
 
@@ -198,59 +250,94 @@ private:
     }
 
     void addData(LogData &&data, bool merge);
-
-    std::vector<LogData> m_data;
+    void setReturnArg(QString &&name, QVariant &&value);
+    static QVariant returnedString(const QString &value);
+    static bool isSameValue(const QVariant &returnValue, const QVariant &paramValue);
+    QString internedName(const QString &name);
+    void updateMemory(LogData &data);
+    void removeOldData();
+
+    std::deque<LogData> m_data;
+    QSet<QString> m_names;
+    qsizetype m_memory = 0;
+    qsizetype m_maxMemory = 0;
 };
 
 /**
  * @brief The LoggerObject class is a utility class to help logging API calls
  *
  * This class ensure that only the first API call is logged, subsequent calls done by the first one won't.
+ * All calls are traced and profiled though, if the Tracer or the Profiler is enabled.
  * Do not use this class directly, but use the macros LOG and LOG_AND_MERGE
  */
 class LoggerObject
 {
 public:
-    explicit LoggerObject(QString name, bool /*unused*/)
-        : LoggerObject()
+    template <typename Function>
+    explicit LoggerObject(const char *name, Function &&logFunction)
+        : m_firstLogger(m_canLog)
     {
-        if (!m_canLog)
-            return;
-
         // When we're running a script, we ideally want to show some kind of feedback.
         // As our scripts currently have to run on the GUI thread, the GUI is blocked.
         // So we need to update the progress bar to show that the script is still running.
         //
-        // We're doing this here, as logging happens quite often in pretty much all scripts.
-        // This has nothing to do with logging itself, but is just a good place to do it.
-        ScriptDialogItem::updateProgress();
-
-        if (m_model)
-            m_model->logData(name);
-        log(std::move(name));
+        // We're doing this here, as API calls happen quite often in pretty much all scripts, even when the logging is
+        // disabled. This has nothing to do with logging itself, the update is throttled by ScriptDialogItem.
+        // Only the outermost call is used, the events must not be processed in the middle of an API call.
+        if (m_callDepth++ == 0)
+            ScriptDialogItem::updateProgress();
+
+        if (m_firstLogger) {
+            m_canLog = false;
+            m_logHistory = m_model != nullptr;
+            m_logTrace = spdlog::default_logger_raw()->should_log(spdlog::level::trace);
+        }
+        m_traced = Tracer::isEnabled();
+
+        // Nothing is formatted if the call isn't logged nor traced.
+        if (m_logHistory || m_logTrace || m_traced)
+            logFunction(*this);
+
+        // Started after the logging work, which is not part of the call itself
+        if (m_traced)
+            m_traceEvent = Tracer::beginEvent(name, std::move(m_traceArguments));
+        if (Profiler::isEnabled())
+            m_profiled = Profiler::beginCall(name);
     }
 
+    ~LoggerObject();
+
     template <typename... Ts>
-    explicit LoggerObject(QString name, bool merge, Ts... params)
-        : LoggerObject()
+    void log(const QString &name, bool merge, Ts... params)
     {
-        if (!m_canLog)
-            return;
-        if (m_model)
-            m_model->logData(name, merge, params...);
-
-        QStringList paramList;
-        (paramList.push_back(valueToString(params)), ...);
-        QString result = name + " - " + paramList.join(", ");
-        log(std::move(result));
+        if constexpr (sizeof...(Ts) == 0) {
+            if (m_logHistory)
+                m_model->logData(name);
+            if (m_logTrace)
+                spdlog::trace(name);
+        } else {
+            if (m_logHistory)
+                m_model->logData(name, merge, params...);
+            if (m_logTrace || m_traced) {
+                // The tracer only keeps the beginning of the arguments, large strings are not formatted entirely
+                const qsizetype maxSize = m_logTrace ? -1 : Tracer::MaxArgumentsSize;
+                QStringList paramList;
+                (paramList.push_back(truncatedValueToString(params, maxSize)), ...);
+                QString arguments = paramList.join(", ");
+                if (m_logTrace)
+                    spdlog::trace(name + " - " + arguments);
+                if (m_traced)
+                    m_traceArguments = std::move(arguments);
+            }
+        }
     }
 
-    ~LoggerObject();
+    bool hasHistory() const { return m_logHistory; }
 
     template <typename T>
     void setReturnValue(QString &&name, const T &value)
     {
-        if (m_firstLogger && m_model)
+        if (hasHistory())
             m_model->setReturnValue(std::move(name), value);
     }
 
@@ -258,11 +345,16 @@ private:
     friend HistoryModel;
     friend LoggerDisabler;
 
-    LoggerObject();
-    void log(QString &&string);
-
     inline static bool m_canLog = true;
+    // Number of API calls in progress, independent from m_canLog which is also changed by LoggerDisabler
+    inline static int m_callDepth = 0;
     bool m_firstLogger = false;
+    bool m_logHistory = false;
+    bool m_logTrace = false;
+    bool m_traced = false;
+    int m_traceEvent = -1;
+    QString m_traceArguments;
+    bool m_profiled = false;
 
     inline static HistoryModel *m_model = nullptr;
 };
@@ -10,11 +10,13 @@
 
 #include "lsp_utils.h"
 #include "codedocument.h"
+#include "lineindex_p.h"
 #include "project.h"
 #include "textdocument.h"
 
-#include <QPlainTextEdit>
-#include <QTextBlock>
+#include <QTextDocument>
+
+#include <algorithm>
 
 namespace Core::Utils {
 
@@ -22,24 +24,24 @@ namespace Core::Utils {
 {
     Lsp::Position position;
 
-    auto cursor = textDocument.textEdit()->textCursor();
-    cursor.setPosition(pos, QTextCursor::MoveAnchor);
+    const auto &lineIndex = textDocument.lineIndex();
+    pos = std::clamp(pos, 0, textDocument.document()->characterCount() - 1);
+    const int line = lineIndex.lineAt(pos);
 
-    position.line = cursor.blockNumber();
-    position.character = cursor.positionInBlock();
+    position.line = line;
+    position.character = pos - lineIndex.lineStart(line);
     return position;
 }
 
 int lspToPos(const TextDocument &textDocument, const Lsp::Position &pos)
 {
-    auto document = textDocument.textEdit()->document();
+    const auto &lineIndex = textDocument.lineIndex();
     // Internally, columns are 0-based, like in LSP
-    const int blockNumber = qMin((int)pos.line, document->blockCount() - 1);
-    const QTextBlock &block = document->findBlockByNumber(blockNumber);
-    if (block.isValid()) {
-        QTextCursor cursor(block);
-        cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, pos.character);
-        return cursor.position();
+    const int line = qMin((int)pos.line, lineIndex.lineCount() - 1);
+    const int start = lineIndex.lineStart(line);
+    if (start != -1) {
+        // A character past the end of the line means the end of the line
+        return qMin(start + (int)pos.character, lineIndex.lineEnd(line));
     }
     return 0;
 }
@@ -14,8 +14,8 @@
 #include "textdocument.h"
 #include "utils/log.h"
 
-#include <QPlainTextEdit>
-#include <QTextDocument>
+#include <algorithm>
+#include <cmath>
 
 namespace Core {
 
@@ -48,6 +48,158 @@ namespace Core {
  * This read-only property returns the document the mark is coming from.
  */
 
+//////////////////////////////////////////////////////////////////////////////
+// MarkRegistry
+//////////////////////////////////////////////////////////////////////////////
+MarkRegistry::Id MarkRegistry::add(int position)
+{
+    Id id;
+    if (m_freeIds.empty()) {
+        id = static_cast<Id>(m_slots.size());
+        m_slots.emplace_back();
+    } else {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+
+    m_slots[id] = {.index = -1, .position = position, .alive = true};
+    m_pendingIds.push_back(id);
+
+    // Keep the pending list small, as each change updates all of its marks, but not too small, as merging it is O(n).
+    const auto maxPending = std::max(64, static_cast<int>(std::sqrt(m_sortedIds.size())));
+    if (static_cast<int>(m_pendingIds.size()) > maxPending)
+        rebuild();
+    return id;
+}
+
+void MarkRegistry::remove(Id id)
+{
+    auto &slot = m_slots[id];
+    Q_ASSERT(slot.alive);
+    slot.alive = false;
+
+    if (slot.index == -1) {
+        std::erase(m_pendingIds, id);
+        m_freeIds.push_back(id);
+    } else {
+        // The sorted position is kept until the next rebuild, the id can only be reused afterwards.
+        ++m_deadCount;
+        if (m_deadCount > static_cast<int>(m_sortedIds.size()) / 2)
+            rebuild();
+    }
+}
+
+int MarkRegistry::position(Id id) const
+{
+    const auto &slot = m_slots[id];
+    return slot.index == -1 ? slot.position : sortedPosition(slot.index);
+}
+
+void MarkRegistry::update(int from, int charsRemoved, int charsAdded)
+{
+    // Same as Mark::updateMark, for all the marks: the marks before `from` don't move, the marks inside the removed
+    // text move to `from`, and the marks after it are shifted.
+    const int first = lowerBound(from);
+    const int last = charsRemoved > 0 ? lowerBound(from + charsRemoved) : first;
+    for (int index = first; index < last; ++index)
+        m_base[index] = from - shiftAt(index);
+    if (charsAdded != charsRemoved && last < static_cast<int>(m_sortedIds.size()))
+        addShift(last, charsAdded - charsRemoved);
+
+    for (auto id : m_pendingIds)
+        Mark::updateMark(m_slots[id].position, from, charsRemoved, charsAdded);
+}
+
+int MarkRegistry::sortedPosition(int index) const
+{
+    return m_base[index] + shiftAt(index);
+}
+
+int MarkRegistry::lowerBound(int position) const
+{
+    // The sorted positions stay sorted after a change, as Mark::updateMark never changes the order of two marks.
+    int low = 0;
+    int high = static_cast<int>(m_sortedIds.size());
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (sortedPosition(middle) < position)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+void MarkRegistry::addShift(int index, int delta)
+{
+    for (int i = index + 1; i <= static_cast<int>(m_shifts.size()); i += i & -i)
+        m_shifts[i - 1] += delta;
+}
+
+int MarkRegistry::shiftAt(int index) const
+{
+    int shift = 0;
+    for (int i = index + 1; i > 0; i -= i & -i)
+        shift += m_shifts[i - 1];
+    return shift;
+}
+
+void MarkRegistry::rebuild()
+{
+    struct Entry
+    {
+        int position;
+        Id id;
+    };
+    std::vector<Entry> entries;
+    entries.reserve(m_sortedIds.size() - m_deadCount + m_pendingIds.size());
+
+    for (int index = 0; index < static_cast<int>(m_sortedIds.size()); ++index) {
+        const auto id = m_sortedIds[index];
+        if (m_slots[id].alive)
+            entries.push_back({sortedPosition(index), id});
+        else
+            m_freeIds.push_back(id);
+    }
+    const auto sortedCount = entries.size();
+    for (auto id : m_pendingIds)
+        entries.push_back({m_slots[id].position, id});
+    auto byPosition = [](const Entry &left, const Entry &right) {
+        return left.position < right.position;
+    };
+    std::sort(entries.begin() + sortedCount, entries.end(), byPosition);
+    std::inplace_merge(entries.begin(), entries.begin() + sortedCount, entries.end(), byPosition);
+
+    m_sortedIds.resize(entries.size());
+    m_base.resize(entries.size());
+    m_shifts.assign(entries.size(), 0);
+    for (int index = 0; index < static_cast<int>(entries.size()); ++index) {
+        m_sortedIds[index] = entries[index].id;
+        m_base[index] = entries[index].position;
+        m_slots[entries[index].id].index = index;
+    }
+    m_pendingIds.clear();
+    m_deadCount = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// MarkPrivate
+//////////////////////////////////////////////////////////////////////////////
+MarkPrivate::MarkPrivate(TextDocument *editor, int pos)
+    : m_editor(editor)
+{
+    Q_ASSERT(editor);
+    auto registry = editor->markRegistry();
+    m_registry = registry;
+    m_id = registry->add(pos);
+}
+
+MarkPrivate::~MarkPrivate()
+{
+    if (auto registry = m_registry.lock())
+        registry->remove(m_id);
+}
+
 bool MarkPrivate::checkEditor() const
 {
     if (!m_editor) {
@@ -59,7 +211,13 @@ bool MarkPrivate::checkEditor() const
 
 bool MarkPrivate::isValid() const
 {
-    return m_editor && m_pos >= 0;
+    return m_editor && position() >= 0;
+}
+
+int MarkPrivate::position() const
+{
+    auto registry = m_registry.lock();
+    return registry ? registry->position(m_id) : -1;
 }
 
 int MarkPrivate::line() const
@@ -68,7 +226,7 @@ int MarkPrivate::line() const
         return -1;
 
     int line, column;
-    m_editor->convertPosition(m_pos, &line, &column);
+    m_editor->convertPosition(position(), &line, &column);
     return line;
 }
 
@@ -78,26 +236,10 @@ int MarkPrivate::column() const
         return -1;
 
     int line, column;
-    m_editor->convertPosition(m_pos, &line, &column);
+    m_editor->convertPosition(position(), &line, &column);
     return column;
 }
 
-void MarkPrivate::update(int from, int charsRemoved, int charsAdded)
-{
-    Mark::updateMark(m_pos, from, charsRemoved, charsAdded);
-}
-
-MarkPrivate::MarkPrivate(TextDocument *editor, int pos)
-    : QObject(nullptr) // Important to have nullptr here, MarkPrivate is managed by shared_ptrs in Mark, MarkPrivate can
-                       // deal with the editor being deleted.
-    , m_editor(editor)
-    , m_pos(pos)
-{
-    Q_ASSERT(editor);
-    auto document = editor->textEdit()->document();
-    connect(document, &QTextDocument::contentsChange, this, &MarkPrivate::update);
-}
-
 Mark::Mark(TextDocument *editor, int pos)
     : d(std::make_shared<MarkPrivate>(editor, pos))
 {
@@ -110,7 +252,7 @@ bool Mark::isValid() const
 
 int Mark::position() const
 {
-    return d ? d->m_pos : -1;
+    return d ? d->position() : -1;
 }
 
 int Mark::line() const
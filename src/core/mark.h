@@ -19,8 +19,8 @@ class TextDocument;
 
 // Mark is shared_ptr to a MarkPrivate.
 // This way we can ensure that a Mark is easy to copy and move
-// around, whilst still ensuring the QObject that listens to the
-// changes of the TextDocument is correctly deleted both from QML and C++.
+// around, whilst still ensuring the position tracked by the
+// TextDocument (see MarkRegistry) is released both from QML and C++.
 class Mark
 {
     Q_GADGET
@@ -10,33 +10,84 @@
 
 #pragma once
 
-#include <QObject>
 #include <QPointer>
 
+#include <memory>
+#include <vector>
+
 namespace Core {
 
 class TextDocument;
 
-class MarkPrivate : public QObject
+/**
+ * Keeps track of the positions of all the marks (Mark and RangeMark) of a TextDocument.
+ *
+ * Instead of having each mark listening to the changes of the document, the TextDocument updates the registry once
+ * per change. Marks are only handles (ids) into the registry.
+ *
+ * The positions are kept sorted, and a change only shifts the marks after it with a Fenwick tree, so updating the
+ * registry is O(log n), plus the marks inside the removed text. Newly added marks are kept aside in a small unsorted
+ * list, which is merged into the sorted positions once it gets too large.
+ */
+class MarkRegistry
 {
-    Q_OBJECT
+public:
+    using Id = int;
+
+    Id add(int position);
+    void remove(Id id);
+    int position(Id id) const;
+
+    // Must be called for every change of the document, with the arguments of QTextDocument::contentsChange.
+    void update(int from, int charsRemoved, int charsAdded);
+
+private:
+    struct Slot
+    {
+        int index = -1; // index in the sorted positions, -1 if the mark is in the pending list
+        int position = -1; // only used when the mark is in the pending list
+        bool alive = false;
+    };
+
+    int sortedPosition(int index) const;
+    // Returns the first index in the sorted positions with a position >= position.
+    int lowerBound(int position) const;
+    void addShift(int index, int delta);
+    int shiftAt(int index) const;
+    void rebuild();
 
+    std::vector<Slot> m_slots;
+    std::vector<Id> m_freeIds;
+    int m_deadCount = 0;
+
+    // Sorted positions: the position at index i is m_base[i] + the sum of m_shifts[0..i].
+    // m_shifts is stored as a Fenwick tree.
+    std::vector<Id> m_sortedIds;
+    std::vector<int> m_base;
+    std::vector<int> m_shifts;
+
+    std::vector<Id> m_pendingIds;
+};
+
+class MarkPrivate
+{
 public:
     // Unfortunately this needs to be public, as otherwise std::make_shared can't access it
     explicit MarkPrivate(TextDocument *editor, int pos);
+    ~MarkPrivate();
 
 private:
     bool isValid() const;
 
+    int position() const;
     int line() const;
     int column() const;
 
     bool checkEditor() const;
 
-    void update(int from, int charsRemoved, int charsAdded);
-
     QPointer<TextDocument> m_editor;
-    int m_pos = -1;
+    std::weak_ptr<MarkRegistry> m_registry;
+    MarkRegistry::Id m_id = -1;
     friend class Mark;
 };
 
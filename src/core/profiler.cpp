@@ -0,0 +1,228 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "profiler.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QPointer>
+#include <QThread>
+#include <QUrl>
+#include <QtQml/private/qqmlengine_p.h>
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Core {
+
+namespace {
+
+struct Entry
+{
+    qint64 totalTime = 0;
+    qint64 selfTime = 0;
+    int count = 0;
+};
+
+struct Call
+{
+    const char *name = nullptr;
+    qint64 start = 0;
+    // Time spent in the API calls done by this one
+    qint64 childrenTime = 0;
+    // Only set for the calls done by the scripts, the innermost function first
+    QStringList functions;
+    QString document;
+};
+
+QElapsedTimer timer;
+std::vector<Call> callStack;
+std::vector<QPointer<QQmlEngine>> engines;
+QString currentDocument;
+
+// API names are string literals, they are compared by content as the same name can be used at different places.
+std::unordered_map<std::string_view, Entry> apiEntries;
+QHash<QString, Entry> functionEntries;
+QHash<QString, Entry> documentEntries;
+// Formatted names of the script functions, keyed by source and function, as formatting them for each call is costly
+QHash<std::pair<QString, QString>, QString> functionNames;
+
+QString functionName(const QV4::StackFrame &frame)
+{
+    const std::pair key {frame.source, frame.function};
+    auto it = functionNames.constFind(key);
+    if (it == functionNames.cend()) {
+        const QString name = frame.function.isEmpty() ? QStringLiteral("<global>") : frame.function;
+        it = functionNames.insert(key, QString("%1 (%2)").arg(name, QFileInfo(QUrl(frame.source).path()).fileName()));
+    }
+    return *it;
+}
+
+// Returns the script functions currently running, the innermost first.
+QStringList scriptFunctions()
+{
+    std::erase_if(engines, [](const auto &engine) {
+        return engine.isNull();
+    });
+    // Only the engine running the script doing the call has a stack
+    for (auto it = engines.crbegin(); it != engines.crend(); ++it) {
+        QV4::ExecutionEngine *v4 = QQmlEnginePrivate::getV4Engine(*it);
+        const QList<QV4::StackFrame> stack = v4->stackTrace();
+        if (stack.isEmpty())
+            continue;
+        QStringList functions;
+        for (const auto &frame : stack) {
+            const QString function = functionName(frame);
+            // Recursive functions are only counted once
+            if (!functions.contains(function))
+                functions.push_back(function);
+        }
+        return functions;
+    }
+    return {};
+}
+
+QString formatTable(const QString &title, std::vector<std::pair<QString, Entry>> &&entries, bool withSelfTime)
+{
+    std::ranges::sort(entries, [](const auto &lhs, const auto &rhs) {
+        return lhs.second.totalTime > rhs.second.totalTime;
+    });
+
+    qsizetype nameWidth = title.size();
+    for (const auto &entry : entries)
+        nameWidth = std::max(nameWidth, entry.first.size());
+
+    auto toMs = [](qint64 ns) {
+        return QString::number(ns / 1000000.0, 'f', 3);
+    };
+    QString result = title.leftJustified(nameWidth) + QString("%1").arg("Total (ms)", 14);
+    if (withSelfTime)
+        result += QString("%1").arg("Self (ms)", 14);
+    result += QString("%1\n").arg("Calls", 10);
+    for (const auto &[name, entry] : entries) {
+        result += name.leftJustified(nameWidth) + QString("%1").arg(toMs(entry.totalTime), 14);
+        if (withSelfTime)
+            result += QString("%1").arg(toMs(entry.selfTime), 14);
+        result += QString("%1\n").arg(entry.count, 10);
+    }
+    return result;
+}
+
+} // namespace
+
+void Profiler::start()
+{
+    if (!timer.isValid())
+        timer.start();
+    m_enabled = true;
+}
+
+void Profiler::stop()
+{
+    m_enabled = false;
+}
+
+void Profiler::clear()
+{
+    apiEntries.clear();
+    functionEntries.clear();
+    documentEntries.clear();
+}
+
+void Profiler::setDocumentName(const QString &name)
+{
+    currentDocument = name;
+}
+
+void Profiler::addEngine(QQmlEngine *engine)
+{
+    engines.push_back(engine);
+}
+
+QString Profiler::report()
+{
+    std::vector<std::pair<QString, Entry>> apis;
+    apis.reserve(apiEntries.size());
+    for (const auto &[name, entry] : apiEntries)
+        apis.emplace_back(QString::fromLatin1(name.data(), static_cast<qsizetype>(name.size())), entry);
+
+    auto toVector = [](const QHash<QString, Entry> &entries) {
+        std::vector<std::pair<QString, Entry>> result;
+        result.reserve(entries.size());
+        for (auto it = entries.cbegin(); it != entries.cend(); ++it)
+            result.emplace_back(it.key(), it.value());
+        return result;
+    };
+
+    return formatTable("API", std::move(apis), true) + '\n'
+        + formatTable("Script functions", toVector(functionEntries), true) + '\n'
+        + formatTable("Documents", toVector(documentEntries), false);
+}
+
+bool Profiler::beginCall(const char *name)
+{
+    if (QThread::currentThread() != qApp->thread())
+        return false;
+
+    Call call {name};
+    // Only the calls done directly by the scripts are related to a script function and a document
+    if (callStack.empty()) {
+        call.functions = scriptFunctions();
+        call.document = currentDocument;
+    }
+    // Started last, looking for the script functions is not part of the call
+    call.start = timer.nsecsElapsed();
+    callStack.push_back(std::move(call));
+    return true;
+}
+
+void Profiler::endCall()
+{
+    Q_ASSERT(!callStack.empty());
+    const Call call = std::move(callStack.back());
+    callStack.pop_back();
+
+    const qint64 duration = timer.nsecsElapsed() - call.start;
+    const qint64 selfTime = duration - call.childrenTime;
+
+    auto &apiEntry = apiEntries[call.name];
+    // Only the outermost call of a recursive API counts for the total time
+    const bool isRecursive = std::ranges::any_of(callStack, [&call](const Call &parent) {
+        return std::string_view(parent.name) == call.name;
+    });
+    if (!isRecursive)
+        apiEntry.totalTime += duration;
+    apiEntry.selfTime += selfTime;
+    ++apiEntry.count;
+
+    if (!callStack.empty()) {
+        callStack.back().childrenTime += duration;
+        return;
+    }
+
+    for (int i = 0; i < call.functions.size(); ++i) {
+        auto &functionEntry = functionEntries[call.functions.at(i)];
+        functionEntry.totalTime += duration;
+        if (i == 0) {
+            functionEntry.selfTime += duration;
+            ++functionEntry.count;
+        }
+    }
+    if (!call.document.isEmpty()) {
+        auto &documentEntry = documentEntries[call.document];
+        documentEntry.totalTime += duration;
+        ++documentEntry.count;
+    }
+}
+
+} // namespace Core
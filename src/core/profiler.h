@@ -0,0 +1,57 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+
+class QQmlEngine;
+
+namespace Core {
+
+/**
+ * @brief Aggregates the time spent in the API calls of the scripts run
+ *
+ * When enabled, every API call using LOG or LOG_AND_MERGE is measured, and the time is aggregated:
+ * - per API: total time, self time (without the API calls it did) and number of calls,
+ * - per script function: time spent in the API calls done by the function (self) or by the function and the
+ *   functions it called (total),
+ * - per document: time spent in the API calls done while it was the current document.
+ * For script functions and documents, the number of calls is the number of API calls done.
+ *
+ * The time spent running the javascript code itself is not measured, only the time spent in Knut.
+ * Only the calls done in the main thread are measured.
+ */
+class Profiler
+{
+public:
+    static void start();
+    static void stop();
+    static bool isEnabled() { return m_enabled; }
+    static void clear();
+
+    // Sets the document used for the next calls
+    static void setDocumentName(const QString &name);
+    // Engines running scripts, used to find the script function doing an API call
+    static void addEngine(QQmlEngine *engine);
+
+    // Returns the aggregated times as tables, sorted by total time
+    static QString report();
+
+    // Returns true if the call is measured, endCall must then be called at the end of the call.
+    // `name` must outlive the profiler (a string literal).
+    static bool beginCall(const char *name);
+    static void endCall();
+
+private:
+    inline static bool m_enabled = false;
+};
+
+} // namespace Core
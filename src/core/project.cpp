@@ -22,6 +22,8 @@
 #include "settings.h"
 #include "slintdocument.h"
 #include "textdocument.h"
+#include "textdocument_p.h"
+#include "utils/aho_corasick.h"
 #include "utils/log.h"
 
 #include <QDir>
@@ -191,6 +193,43 @@ QStringList Project::allFilesWithExtensions(const QStringList &extensions, PathT
     return result;
 }
 
+// clang-format off
+/*!
+ * \qmlmethod int Project::replaceAllMany(array<string> fileNames, object replacements, int options = TextDocument.NoFindFlags)
+ * Replaces all occurrences of the keys of `replacements` with their values in all the files `fileNames`, see
+ * `TextDocument::replaceAllMany`. The automaton used to find the keys is only built once for all the files.
+ *
+ * The documents are opened if needed, but not saved.
+ *
+ * Returns the number of changes done in all the documents.
+ */
+// clang-format on
+int Project::replaceAllMany(const QStringList &fileNames, const QVariantMap &replacements, int options)
+{
+    LOG("Project::replaceAllMany", fileNames, replacements, options);
+    if (options & TextDocument::FindRegexp) {
+        spdlog::error("Project::replaceAllMany - regexps are not supported");
+        return 0;
+    }
+
+    QStringList afters;
+    afters.reserve(replacements.size());
+    for (const auto &value : replacements)
+        afters.push_back(value.toString());
+    const auto matcher = createAhoCorasick(replacements.keys(), options);
+
+    int count = 0;
+    for (const auto &fileName : fileNames) {
+        auto document = qobject_cast<TextDocument *>(getDocument(fileName));
+        if (!document) {
+            spdlog::warn("Project::replaceAllMany - {} is not a text document", fileName);
+            continue;
+        }
+        count += document->replaceAllMany(matcher, afters, options);
+    }
+    return count;
+}
+
 static Document *createDocument(const QString &suffix)
 {
     static const auto mimeTypes =
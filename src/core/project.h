@@ -13,6 +13,7 @@
 #include "document.h"
 
 #include <QObject>
+#include <QVariantMap>
 #include <unordered_map>
 
 namespace Lsp {
@@ -53,6 +54,7 @@ public:
                                                   Core::Project::PathType type = RelativeToRoot);
     Q_INVOKABLE QStringList allFilesWithExtensions(const QStringList &extensions,
                                                    Core::Project::PathType type = RelativeToRoot);
+    Q_INVOKABLE int replaceAllMany(const QStringList &fileNames, const QVariantMap &replacements, int options = 0);
 
 public slots:
     Core::Document *get(const QString &fileName);
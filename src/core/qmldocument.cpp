@@ -10,25 +10,16 @@
 
 #include "qmldocument.h"
 #include "codedocument_p.h"
-#include <kdalgorithms.h>
 
 namespace {
 using namespace Core;
 
-auto queryUIObjectSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+QList<TreeSitterHelper::SymbolQuery> symbolQueries()
 {
-    const auto queryString = QString(R"EOF(
+    const auto uiObjectQuery = QString(R"EOF(
         (ui_object_definition type_name : (_) @name @selectionRange) @range
     )EOF");
-    auto uiObjectDefinitions = document->query(queryString);
-    auto objectsToSymbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Object);
-    };
-    return kdalgorithms::transformed<QList<Symbol *>>(uiObjectDefinitions, objectsToSymbol);
-}
-auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
-{
-    const auto queryString = QString(R"EOF(
+    const auto functionQuery = QString(R"EOF(
         (function_declaration
         name:(_) @name @selectionRange
         parameters: (formal_parameters
@@ -37,40 +28,19 @@ auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
         body: (_) @body
         ) @range
     )EOF");
-    auto functions = document->query(queryString);
-
-    auto function_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Function);
-    };
-
-    return kdalgorithms::transformed<QList<Symbol *>>(functions, function_to_symbol);
-}
-
-auto queryPropertySymbols(CodeDocument *const document) -> QList<Core::Symbol *>
-{
-    const auto queryString = QString(R"EOF(
+    const auto propertyQuery = QString(R"EOF(
         (ui_binding
         name: (_) @name @selectionRange
         value: ((_)@type)
         @value) @range
 
     )EOF");
-    auto members = document->query(queryString);
 
-    auto member_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Field);
+    return {
+        TreeSitterHelper::SymbolQuery::ofKind(uiObjectQuery, Symbol::Kind::Object),
+        TreeSitterHelper::SymbolQuery::ofKind(functionQuery, Symbol::Kind::Function),
+        TreeSitterHelper::SymbolQuery::ofKind(propertyQuery, Symbol::Kind::Field),
     };
-
-    return kdalgorithms::transformed<QList<Symbol *>>(members, member_to_symbol);
-}
-
-auto queryAllSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
-{
-    auto symbols = ::queryUIObjectSymbols(document);
-    symbols.append(::queryFunctionSymbols(document));
-    symbols.append(::queryPropertySymbols(document));
-
-    return symbols;
 }
 
 }
@@ -80,7 +50,7 @@ namespace Core {
 QmlDocument::QmlDocument(QObject *parent)
     : CodeDocument(Type::Qml, parent)
 {
-    helper()->querySymbols = ::queryAllSymbols;
+    helper()->symbolQueries = ::symbolQueries();
 }
 
 QmlDocument::~QmlDocument() = default;
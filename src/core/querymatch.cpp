@@ -10,12 +10,16 @@
 
 #include "querymatch.h"
 #include "codedocument.h"
+#include "mark.h"
+#include "querymatch_p.h"
 #include "rangemark.h"
 #include "textdocument.h"
 #include "utils/log.h"
 
 #include <QJSEngine>
+#include <QPlainTextEdit>
 #include <kdalgorithms.h>
+#include <optional>
 #include <treesitter/query.h>
 
 namespace Core {
@@ -83,26 +87,47 @@ QString QueryCapture::toString() const
  */
 
 QueryMatch::QueryMatch(TextDocument &document, const treesitter::QueryMatch &match)
+    : QueryMatch(std::make_shared<QueryCaptureStore>(&document, match.query()), match)
 {
-    const auto captures = match.captures();
-    for (const auto &capture : captures) {
-        const auto name = match.query()->captureAt(capture.id).name;
+}
 
-        const auto &node = capture.node;
-        const auto range = document.createRangeMark(node.startPosition(), node.endPosition());
+QueryMatch::QueryMatch(const std::shared_ptr<QueryCaptureStore> &store, const treesitter::QueryMatch &match)
+    : m_store(store)
+{
+    m_first = m_store->add(match);
+    m_count = m_store->count() - m_first;
+}
 
-        m_captures.emplace_back(QueryCapture {.name = name, .range = range});
+QList<QueryCapture> QueryMatch::captures() const
+{
+    QList<QueryCapture> captures;
+    captures.reserve(m_count);
+    for (auto index = m_first; index < m_first + m_count; ++index) {
+        captures.emplace_back(QueryCapture {.name = m_store->name(index), .range = m_store->range(index)});
     }
+    return captures;
 }
 
-const QList<QueryCapture> &QueryMatch::captures() const
+bool QueryMatch::isEmpty() const
 {
-    return m_captures;
+    return m_count == 0;
 }
 
-bool QueryMatch::isEmpty() const
+// Calls func with the index in the store of each capture named `name`, until func returns false.
+template <typename Func>
+void QueryMatch::forEachCapture(const QString &name, Func func) const
 {
-    return m_captures.isEmpty();
+    if (!m_store)
+        return;
+
+    const auto id = m_store->captureId(name);
+    if (id == -1)
+        return;
+
+    for (auto index = m_first; index < m_first + m_count; ++index) {
+        if (m_store->id(index) == id && !func(index))
+            return;
+    }
 }
 
 /*!
@@ -112,12 +137,10 @@ bool QueryMatch::isEmpty() const
 Core::RangeMarkList QueryMatch::getAll(const QString &name) const
 {
     Core::RangeMarkList result;
-
-    for (const auto &capture : m_captures) {
-        if (capture.name == name)
-            result.emplace_back(capture.range);
-    }
-
+    forEachCapture(name, [this, &result](qsizetype index) {
+        result.emplace_back(m_store->range(index));
+        return true;
+    });
     return result;
 }
 
@@ -127,13 +150,13 @@ Core::RangeMarkList QueryMatch::getAll(const QString &name) const
  */
 Core::RangeMarkList QueryMatch::getAllInRange(const QString &name, const Core::RangeMark &range) const
 {
-    auto captureMatch = [&name, &range](const QueryCapture &capture) {
-        return capture.name == name && range.contains(capture.range);
-    };
-    auto toRange = [](const QueryCapture &capture) {
-        return capture.range;
-    };
-    return kdalgorithms::filtered_transformed(m_captures, toRange, captureMatch);
+    Core::RangeMarkList result;
+    forEachCapture(name, [this, &range, &result](qsizetype index) {
+        if (isInRange(range, index))
+            result.emplace_back(m_store->range(index));
+        return true;
+    });
+    return result;
 }
 
 /*!
@@ -154,12 +177,12 @@ Core::RangeMarkList QueryMatch::getAllInRange(const QString &name, const Core::R
  */
 RangeMark QueryMatch::get(const QString &name) const
 {
-    for (const auto &capture : m_captures) {
-        if (capture.name == name)
-            return capture.range;
-    }
-
-    return RangeMark();
+    RangeMark result;
+    forEachCapture(name, [this, &result](qsizetype index) {
+        result = m_store->range(index);
+        return false;
+    });
+    return result;
 }
 
 /*!
@@ -168,13 +191,14 @@ RangeMark QueryMatch::get(const QString &name) const
  */
 Core::RangeMark QueryMatch::getInRange(const QString &name, const Core::RangeMark &range) const
 {
-    auto captureMatch = [&name, &range](const QueryCapture &capture) {
-        return capture.name == name && range.contains(capture.range);
-    };
-    auto result = kdalgorithms::find_if(m_captures, captureMatch);
-    if (result)
-        return result->range;
-    return {};
+    RangeMark result;
+    forEachCapture(name, [this, &range, &result](qsizetype index) {
+        if (!isInRange(range, index))
+            return true;
+        result = m_store->range(index);
+        return false;
+    });
+    return result;
 }
 
 /*!
@@ -183,12 +207,19 @@ Core::RangeMark QueryMatch::getInRange(const QString &name, const Core::RangeMar
  */
 RangeMark QueryMatch::getAllJoined(const QString &name) const
 {
-    auto ranges = getAll(name);
+    // Join the positions directly, so only the resulting RangeMark is created.
+    std::optional<std::pair<int, int>> joined;
+    forEachCapture(name, [this, &joined](qsizetype index) {
+        const auto start = m_store->start(index);
+        const auto end = m_store->end(index);
+        joined = joined ? std::make_pair(std::min(joined->first, start), std::max(joined->second, end))
+                        : std::make_pair(start, end);
+        return true;
+    });
 
-    if (ranges.isEmpty())
+    if (!joined || !m_store->document())
         return RangeMark();
-
-    return kdalgorithms::accumulate(ranges, &RangeMark::join, ranges.at(0));
+    return RangeMark(m_store->document(), joined->first, joined->second);
 }
 
 /**
@@ -232,7 +263,111 @@ Core::QueryMatchList QueryMatch::queryIn(const QString &capture, const QString &
 
 QString QueryMatch::toString() const
 {
-    return QString("QueryMatch{%1}").arg(m_captures.size());
+    return QString("QueryMatch{%1}").arg(m_count);
+}
+
+bool QueryMatch::isInRange(const Core::RangeMark &range, qsizetype index) const
+{
+    return range.isValid() && range.document() == m_store->document() && range.start() <= m_store->start(index)
+        && m_store->end(index) <= range.end();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// QueryCaptureStore
+//////////////////////////////////////////////////////////////////////////////
+QueryCaptureStore::QueryCaptureStore(TextDocument *document, const std::shared_ptr<treesitter::Query> &query)
+    : m_document(document)
+    , m_names(kdalgorithms::transformed<QStringList>(query->captures(),
+                                                     [](const treesitter::Query::Capture &capture) {
+                                                         return capture.name;
+                                                     }))
+{
+    Q_ASSERT(document);
+
+    // Only record the change, it's applied to the captures when they are accessed again.
+    // Like the marks, the captures between the matches of a replaceAll are updated with each replacement.
+    connect(document, &TextDocument::positionsChange, this, [this](int from, int charsRemoved, int charsAdded) {
+        if (!m_captures.empty())
+            m_pendingEdits.push_back({from, charsRemoved, charsAdded});
+    });
+}
+
+qsizetype QueryCaptureStore::add(const treesitter::QueryMatch &match)
+{
+    // The new captures are at their position in the current text, the existing ones need to be updated first.
+    applyPendingEdits();
+
+    const auto first = static_cast<qsizetype>(m_captures.size());
+    const auto captures = match.captures();
+    for (const auto &capture : captures) {
+        m_captures.push_back({.start = static_cast<int>(capture.node.startPosition()),
+                              .end = static_cast<int>(capture.node.endPosition()),
+                              .id = static_cast<int>(capture.id)});
+    }
+    return first;
+}
+
+qsizetype QueryCaptureStore::count() const
+{
+    return static_cast<qsizetype>(m_captures.size());
+}
+
+int QueryCaptureStore::captureId(const QString &name) const
+{
+    return static_cast<int>(m_names.indexOf(name));
+}
+
+const QString &QueryCaptureStore::name(qsizetype index) const
+{
+    return m_names.at(m_captures.at(index).id);
+}
+
+int QueryCaptureStore::id(qsizetype index) const
+{
+    return m_captures.at(index).id;
+}
+
+int QueryCaptureStore::start(qsizetype index)
+{
+    applyPendingEdits();
+    return m_captures.at(index).start;
+}
+
+int QueryCaptureStore::end(qsizetype index)
+{
+    applyPendingEdits();
+    return m_captures.at(index).end;
+}
+
+RangeMark QueryCaptureStore::range(qsizetype index)
+{
+    if (!m_document) {
+        spdlog::error("QueryMatch: document does not exist anymore");
+        return {};
+    }
+    // From now on, the RangeMark keeps track of the changes of the document itself.
+    return RangeMark(m_document, start(index), end(index));
+}
+
+TextDocument *QueryCaptureStore::document() const
+{
+    return m_document;
+}
+
+void QueryCaptureStore::applyPendingEdits()
+{
+    if (m_pendingEdits.empty())
+        return;
+
+    for (auto &capture : m_captures) {
+        for (const auto &edit : m_pendingEdits) {
+            Mark::updateMark(capture.start, edit.from, edit.charsRemoved, edit.charsAdded);
+            Mark::updateMark(capture.end, edit.from, edit.charsRemoved, edit.charsAdded);
+        }
+        if (capture.start > capture.end)
+            std::swap(capture.start, capture.end);
+    }
+    m_pendingEdits.clear();
 }
 
 } // namespace Core
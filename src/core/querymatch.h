@@ -13,6 +13,7 @@
 #include "rangemark.h"
 
 #include <QObject>
+#include <memory>
 
 namespace treesitter {
 class QueryMatch;
@@ -21,6 +22,7 @@ class QueryMatch;
 namespace Core {
 
 class TextDocument;
+class QueryCaptureStore;
 
 class QueryCapture
 {
@@ -47,8 +49,10 @@ public:
     // Default constructor is required for Q_DECLARE_METATYPE
     QueryMatch() = default;
     QueryMatch(TextDocument &document, const treesitter::QueryMatch &match);
+    // Matches of the same query can share the store of their captures, see QueryCaptureStore.
+    QueryMatch(const std::shared_ptr<QueryCaptureStore> &store, const treesitter::QueryMatch &match);
 
-    const QList<QueryCapture> &captures() const;
+    QList<QueryCapture> captures() const;
     bool isEmpty() const;
 
     // Access to captures
@@ -75,7 +79,13 @@ public:
     Q_INVOKABLE QString toString() const;
 
 private:
-    QList<QueryCapture> m_captures;
+    template <typename Func>
+    void forEachCapture(const QString &name, Func func) const;
+    bool isInRange(const Core::RangeMark &range, qsizetype index) const;
+
+    std::shared_ptr<QueryCaptureStore> m_store;
+    qsizetype m_first = 0;
+    qsizetype m_count = 0;
 };
 
 using QueryMatchList = QList<Core::QueryMatch>;
@@ -0,0 +1,80 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "rangemark.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <memory>
+#include <vector>
+
+namespace treesitter {
+class Query;
+class QueryMatch;
+}
+
+namespace Core {
+
+class TextDocument;
+
+// Stores the captures of the matches of a query, shared by all the matches returned by a single query call.
+//
+// Creating a RangeMark for each capture would create one QObject listening to the document changes per capture.
+// Instead, the captures are kept as plain positions, and a single QObject records the changes of the document.
+// The changes are only applied to the positions when the captures are accessed again, and a RangeMark is only
+// created when a script asks for the range of a capture.
+class QueryCaptureStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QueryCaptureStore(TextDocument *document, const std::shared_ptr<treesitter::Query> &query);
+
+    // Adds the captures of the match, and returns the index of the first one.
+    qsizetype add(const treesitter::QueryMatch &match);
+    qsizetype count() const;
+
+    // Returns the capture id for the given name, or -1 if the query has no such capture.
+    int captureId(const QString &name) const;
+
+    const QString &name(qsizetype index) const;
+    int id(qsizetype index) const;
+    int start(qsizetype index);
+    int end(qsizetype index);
+    RangeMark range(qsizetype index);
+
+    TextDocument *document() const;
+
+private:
+    struct Capture
+    {
+        int start;
+        int end; // exclusive
+        int id;
+    };
+    struct Edit
+    {
+        int from;
+        int charsRemoved;
+        int charsAdded;
+    };
+
+    void applyPendingEdits();
+
+    QPointer<TextDocument> m_document;
+    QStringList m_names;
+    std::vector<Capture> m_captures;
+    std::vector<Edit> m_pendingEdits;
+};
+
+} // namespace Core
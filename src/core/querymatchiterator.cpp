@@ -0,0 +1,132 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "querymatchiterator.h"
+#include "codedocument.h"
+#include "utils/log.h"
+
+#include <QPlainTextEdit>
+#include <QTextDocument>
+
+namespace Core {
+
+/*!
+ * \qmltype QueryMatchIterator
+ * \brief Iterates over the matches of a query, finding them one at a time.
+ * \ingroup CodeDocument
+ * \sa CodeDocument::queryIterator
+ *
+ * Unlike `CodeDocument::query`, the matches are only searched for when they are requested, so the first matches are
+ * available immediately and the memory used doesn't grow with the number of matches. This is useful on large
+ * documents, or when only a few matches are needed.
+ *
+ * ```js
+ * let functions = document.queryIterator("(function_definition) @function");
+ * while (functions.hasNext()) {
+ *     let match = functions.next();
+ *     // ...
+ * }
+ * ```
+ *
+ * If the document is modified during the iteration, the iteration stops: the tree the query runs on is not valid
+ * anymore.
+ */
+
+QueryMatchIterator::QueryMatchIterator(CodeDocument *document, std::optional<treesitter::QueryCursor> &&cursor,
+                                       QObject *parent)
+    : QObject(parent)
+    , m_document(document)
+    , m_cursor(std::move(cursor))
+{
+    if (m_document) {
+        // Any change invalidates the tree the cursor runs on.
+        connect(m_document->document(), &QTextDocument::contentsChange, this, [this]() {
+            if (m_cursor) {
+                spdlog::warn("QueryMatchIterator: The document was modified, stopping the iteration");
+                stop();
+            }
+        });
+    }
+}
+
+QueryMatchIterator::~QueryMatchIterator() = default;
+
+void QueryMatchIterator::fetchNext()
+{
+    if (m_next || !m_cursor)
+        return;
+
+    // The cursor can't be used anymore once the document, and its tree, are gone.
+    if (!m_document) {
+        stop();
+        return;
+    }
+
+    if (auto match = m_cursor->nextMatch()) {
+        m_next = QueryMatch(*m_document, *match);
+    } else {
+        stop();
+    }
+}
+
+void QueryMatchIterator::stop()
+{
+    if (m_cursor) {
+        m_exceededMatchLimit = m_cursor->didExceedMatchLimit();
+        m_cursor = {};
+    }
+}
+
+/*!
+ * \qmlmethod bool QueryMatchIterator::hasNext()
+ * Returns true if there's another match, false once all matches have been returned.
+ */
+bool QueryMatchIterator::hasNext()
+{
+    fetchNext();
+    return m_next.has_value();
+}
+
+/*!
+ * \qmlmethod QueryMatch QueryMatchIterator::next()
+ * Returns the next match, or an empty match if there are no more matches.
+ */
+Core::QueryMatch QueryMatchIterator::next()
+{
+    fetchNext();
+    if (!m_next)
+        return {};
+    return std::exchange(m_next, std::nullopt).value();
+}
+
+/*!
+ * \qmlmethod array<QueryMatch> QueryMatchIterator::take(int count)
+ * Returns the next `count` matches, or less if there are not enough matches left.
+ */
+Core::QueryMatchList QueryMatchIterator::take(int count)
+{
+    Core::QueryMatchList matches;
+    while (count-- > 0 && hasNext()) {
+        matches.push_back(next());
+    }
+    return matches;
+}
+
+/*!
+ * \qmlmethod bool QueryMatchIterator::exceededMatchLimit()
+ * Returns true if the match limit given to `CodeDocument::queryIterator` was exceeded, in which case some matches
+ * may be missing.
+ */
+bool QueryMatchIterator::exceededMatchLimit() const
+{
+    return m_cursor ? m_cursor->didExceedMatchLimit() : m_exceededMatchLimit;
+}
+
+} // namespace Core
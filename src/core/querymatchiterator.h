@@ -0,0 +1,52 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "querymatch.h"
+#include "treesitter/query.h"
+
+#include <QObject>
+#include <QPointer>
+#include <optional>
+#include <utility>
+
+namespace Core {
+
+class CodeDocument;
+
+class QueryMatchIterator : public QObject
+{
+    Q_OBJECT
+
+public:
+    // The iterator needs to be created right after the cursor is executed, before the document is modified.
+    QueryMatchIterator(CodeDocument *document, std::optional<treesitter::QueryCursor> &&cursor,
+                       QObject *parent = nullptr);
+    ~QueryMatchIterator() override;
+
+    Q_INVOKABLE bool hasNext();
+    Q_INVOKABLE Core::QueryMatch next();
+    Q_INVOKABLE Core::QueryMatchList take(int count);
+    Q_INVOKABLE bool exceededMatchLimit() const;
+
+private:
+    void fetchNext();
+    void stop();
+
+    QPointer<CodeDocument> m_document;
+    std::optional<treesitter::QueryCursor> m_cursor;
+    // Next match, fetched ahead for hasNext.
+    // It's a Core::QueryMatch, so its ranges stay valid if the document is modified.
+    std::optional<Core::QueryMatch> m_next;
+    bool m_exceededMatchLimit = false;
+};
+
+} // namespace Core
@@ -9,13 +9,10 @@
 */
 
 #include "rangemark.h"
-#include "mark.h"
 #include "rangemark_p.h"
 #include "textdocument.h"
 #include "utils/log.h"
 
-#include <QPlainTextEdit>
-
 namespace Core {
 
 /*!
@@ -51,16 +48,28 @@ namespace Core {
 
 RangeMarkPrivate::RangeMarkPrivate(TextDocument *editor, int start, int end)
     : m_editor(editor)
-    , m_start(start)
-    , m_end(end)
 {
-    ensureInvariant();
-
     Q_ASSERT(editor);
+
+    if (start > end) {
+        spdlog::warn("RangeMark::RangeMarkPrivate: invariant violated: start > end ({} > {})", start, end);
+        std::swap(start, end);
+    }
+
+    auto registry = editor->markRegistry();
+    m_registry = registry;
+    m_start = registry->add(start);
+    m_end = registry->add(end);
+
     Q_ASSERT(isValid());
+}
 
-    auto document = editor->textEdit()->document();
-    connect(document, &QTextDocument::contentsChange, this, &RangeMarkPrivate::update);
+RangeMarkPrivate::~RangeMarkPrivate()
+{
+    if (auto registry = m_registry.lock()) {
+        registry->remove(m_start);
+        registry->remove(m_end);
+    }
 }
 
 bool RangeMarkPrivate::checkEditor() const
@@ -72,24 +81,21 @@ bool RangeMarkPrivate::checkEditor() const
     return true;
 }
 
-void RangeMarkPrivate::ensureInvariant()
+int RangeMarkPrivate::start() const
 {
-    if (m_start > m_end) {
-        spdlog::warn("RangeMark::ensureInvariant: invariant violated: m_start > m_end ({} > {})", m_start, m_end);
-        std::swap(m_start, m_end);
-    }
+    auto registry = m_registry.lock();
+    return registry ? registry->position(m_start) : -1;
 }
 
-void RangeMarkPrivate::update(int from, int charsRemoved, int charsAdded)
+int RangeMarkPrivate::end() const
 {
-    Mark::updateMark(m_start, from, charsRemoved, charsAdded);
-    Mark::updateMark(m_end, from, charsRemoved, charsAdded);
-    ensureInvariant();
+    auto registry = m_registry.lock();
+    return registry ? registry->position(m_end) : -1;
 }
 
 bool RangeMarkPrivate::isValid() const
 {
-    return checkEditor() && m_start >= 0 && m_end >= 0;
+    return checkEditor() && start() >= 0 && end() >= 0;
 }
 
 RangeMark::RangeMark(TextDocument *editor, int start, int end)
@@ -104,12 +110,12 @@ bool RangeMark::isValid() const
 
 int RangeMark::start() const
 {
-    return d ? d->m_start : -1;
+    return d ? d->start() : -1;
 }
 
 int RangeMark::end() const
 {
-    return d ? d->m_end : -1;
+    return d ? d->end() : -1;
 }
 
 int RangeMark::length() const
@@ -19,8 +19,8 @@ class TextDocument;
 
 // RangeMark is shared_ptr to a RangeMarkPrivate.
 // This way we can ensure that a RangeMark is easy to copy and move
-// around, whilst still ensuring the QObject that listens to the
-// changes of the TextDocument is correctly deleted both from QML and C++.
+// around, whilst still ensuring the positions tracked by the
+// TextDocument (see MarkRegistry) are released both from QML and C++.
 class RangeMark
 {
     Q_GADGET
@@ -10,39 +10,36 @@
 
 #pragma once
 
-#include <QObject>
+#include "mark_p.h"
+
 #include <QPointer>
 
 namespace Core {
 
 class TextDocument;
 
-class RangeMarkPrivate : public QObject
+class RangeMarkPrivate
 {
-    Q_OBJECT
-
 public:
     // Unfortunately this needs to be public, as otherwise std::make_shared can't access it
     explicit RangeMarkPrivate(TextDocument *editor, int start, int end);
+    ~RangeMarkPrivate();
 
 private:
-    void ensureInvariant();
-
     bool isValid() const;
     bool checkEditor() const;
 
-    void update(int from, int charsRemoved, int charsAdded);
+    int start() const;
+    int end() const;
 
     QPointer<TextDocument> m_editor;
+    std::weak_ptr<MarkRegistry> m_registry;
 
-    // We need to uphold the invariant
-    // that m_start <= m_end
-    //
-    // Encoding with m_start + m_length would remove this requirement,
-    // however, it would make update() more complicated.
-    int m_start;
-    // Note: m_end is exclusive
-    int m_end;
+    // The registry keeps the order of the positions, so the invariant
+    // that start <= end is upheld once the range is created.
+    MarkRegistry::Id m_start = -1;
+    // Note: the end is exclusive
+    MarkRegistry::Id m_end = -1;
 
     friend class RangeMark;
     friend class AstNode;
@@ -28,6 +28,7 @@
 #include <QCoreApplication>
 #include <QDialogButtonBox>
 #include <QDoubleSpinBox>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QJsonDocument>
@@ -47,6 +48,11 @@
 
 namespace Core {
 
+// Interval in milliseconds between two updates of the progress dialogs, while a script is running
+static constexpr int ProgressInterval = 30;
+// Time since the last update of the progress dialogs
+static QElapsedTimer progressTimer;
+
 /*!
  * \qmltype ScriptDialog
  * \brief QML Item for writing visual scripts.
@@ -241,7 +247,7 @@ void ScriptDialogItem::firstStep(const QString &firstStep)
     showProgressDialog();
     m_currentStep = 0;
     nextStep(firstStep);
-    updateProgress();
+    processProgressEvents();
 }
 
 /**
@@ -452,7 +458,7 @@ void ScriptDialogItem::showProgressDialog()
 
     m_progressDialogs.push_back(m_progressDialog);
     m_progressDialog->show();
-    updateProgress();
+    processProgressEvents();
 }
 
 void ScriptDialogItem::cleanupProgressDialog()
@@ -466,9 +472,17 @@ void ScriptDialogItem::cleanupProgressDialog()
 }
 
 void ScriptDialogItem::updateProgress()
+{
+    // Processing the events is slow, and this is called for each API call: only do it from time to time
+    if (!m_progressDialogs.empty() && (!progressTimer.isValid() || progressTimer.hasExpired(ProgressInterval)))
+        processProgressEvents();
+}
+
+void ScriptDialogItem::processProgressEvents()
 {
     if (!m_progressDialogs.empty()) {
         QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+        progressTimer.start();
     }
 }
 
@@ -49,6 +49,7 @@ public:
     // This method is used to redraw the application while a script is running
     // Long-running scripts will otherwise block the GUI, which may look like Knut is hung up.
     // This method should be called in regular intervals to ensure visual progress.
+    // It's cheap to call often: the events are only processed every ProgressInterval milliseconds.
     static void updateProgress();
 
     bool isInteractive() const;
@@ -92,6 +93,8 @@ private:
 
     void applySyntaxHighlighting(QTextDocument *document, const QString &syntax);
 
+    static void processProgressEvents();
+
 private:
     DynamicObject *m_data;
     std::vector<QObject *> m_children;
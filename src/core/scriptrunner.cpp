@@ -17,9 +17,11 @@
 #include "functionsymbol.h"
 #include "mark.h"
 #include "message.h"
+#include "profiler.h"
 #include "project.h"
 #include "qttsdocument.h"
 #include "qtuidocument.h"
+#include "querymatchiterator.h"
 #include "rcdocument.h"
 #include "scriptdialogitem.h"
 #include "scriptitem.h"
@@ -102,6 +104,8 @@ ScriptRunner::ScriptRunner(QObject *parent)
     qmlRegisterUncreatableType<QtUiWidget>("Knut", 1, 0, "QtUiWidget", "Only created by QtUiDocument");
     qmlRegisterType<CppDocument>("Knut", 1, 0, "CppDocument");
     qmlRegisterUncreatableType<Core::Symbol>("Knut", 1, 0, "Symbol", "Only created by CodeDocument");
+    qmlRegisterUncreatableType<Core::QueryMatchIterator>("Knut", 1, 0, "QueryMatchIterator",
+                                                         "Only created by CodeDocument");
     qmlRegisterType<RcDocument>("Knut", 1, 0, "RcDocument");
     qmlRegisterType<QtTsDocument>("Knut", 1, 0, "QtTsDocument");
     qmlRegisterUncreatableType<QtTsMessage>("Knut", 1, 0, "QtTsMessage", "Only created by QtTsDocument");
@@ -273,6 +277,7 @@ QQmlEngine *ScriptRunner::getEngine(const QString &fileName)
     engine->setProperty("scriptPath", fi.absolutePath());
     engine->setProperty("scriptWindow", false);
     engine->addImportPath("qrc:/qml");
+    Profiler::addEngine(engine);
 
     auto logWarnings = [this](const QList<QQmlError> &warnings) {
         for (const auto &warning : warnings) {
@@ -74,6 +74,13 @@ Settings::Settings(Mode mode, QObject *parent)
     Q_ASSERT(m_instance == nullptr);
     m_instance = this;
 
+    ++m_revision;
+    auto increaseRevision = []() {
+        ++m_revision;
+    };
+    connect(this, &Settings::settingsLoaded, this, increaseRevision);
+    connect(this, &Settings::settingsChanged, this, increaseRevision);
+
     loadKnutSettings();
     if (!isTesting()) // Only load if not testing
         loadUserSettings();
@@ -275,6 +282,11 @@ bool Settings::hasLsp() const
     return m_mode == Mode::Test || (m_mode == Mode::Gui && DEFAULT_VALUE(bool, EnableLSP));
 }
 
+int Settings::revision() const
+{
+    return m_revision;
+}
+
 void Settings::loadKnutSettings()
 {
     QFile file(":/core/settings.json");
@@ -51,9 +51,12 @@ public:
     static inline constexpr char RcLanguageMap[] = "/rc/language_map";
     static inline constexpr char CppExcludedMacros[] = "/cpp/excluded_macros";
     static inline constexpr char SaveLogsToFile[] = "/logs/saveToFile";
+    static inline constexpr char HistoryMaxMemory[] = "/logs/historyMaxMemory";
     static inline constexpr char ScriptPaths[] = "/script_paths";
     static inline constexpr char Tab[] = "/text_editor/tab";
     static inline constexpr char ToggleSection[] = "/toggle_section";
+    static inline constexpr char TreeSitterMaxFileSize[] = "/treesitter/max_file_size";
+    static inline constexpr char TreeSitterParseTimeout[] = "/treesitter/parse_timeout";
 
 public:
     ~Settings() override;
@@ -111,6 +114,10 @@ public:
     bool isTesting() const;
     bool hasLsp() const;
 
+    // Incremented every time the settings are created, loaded or changed, so values derived from them can be cached.
+    // The revision is shared by all instances: a new instance never reuses the revision of a previous one.
+    int revision() const;
+
 public slots:
     bool setValue(QString path, const QJSValue &value);
 
@@ -139,6 +146,7 @@ private:
     void saveOnExit();
 
     inline static Settings *m_instance = nullptr;
+    inline static int m_revision = 0;
 
     nlohmann::json m_settings;
     nlohmann::json m_userSettings;
@@ -9,24 +9,33 @@
 */
 
 #include "textdocument.h"
+#include "lineindex_p.h"
 #include "logger.h"
 #include "mark.h"
+#include "mark_p.h"
 #include "rangemark.h"
 #include "settings.h"
 #include "textdocument_p.h"
 #include "texteditor.h"
+#include "utils/aho_corasick.h"
 #include "utils/log.h"
 #include "utils/string_helper.h"
 
+#include <QClipboard>
 #include <QFile>
+#include <QGuiApplication>
+#include <QHash>
 #include <QKeyEvent>
 #include <QPlainTextEdit>
 #include <QRegularExpression>
 #include <QSignalBlocker>
 #include <QTextBlock>
+#include <QTextDocumentFragment>
 #include <QTextStream>
 #include <private/qwidgettextcontrol_p.h>
 
+#include <algorithm>
+
 namespace Core {
 
 static std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>
@@ -63,6 +72,57 @@ matchInBlock(const QTextBlock &block, const QRegularExpression &expr, int offset
     return {};
 }
 
+// Searches `text` in `snapshot` (see TextDocument::searchSnapshot) without any regexp, starting at `from` (backward,
+// the match starts at or before `from`). Like QTextDocument::find, a match can't span several blocks.
+// QStringView::indexOf is vectorized, which is much faster than searching block by block with a QTextCursor.
+static qsizetype findLiteral(QStringView snapshot, QStringView text, qsizetype from, int options)
+{
+    // The blocks are separated by QChar::ParagraphSeparator in the snapshot, and a line break is never in a block.
+    if (text.isEmpty() || text.contains(QChar::ParagraphSeparator) || text.contains(u'\n'))
+        return -1;
+
+    const bool backward = options & TextDocument::FindBackward;
+    const auto caseSensitivity =
+        (options & TextDocument::FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    while (from >= 0 && from <= snapshot.size()) {
+        const auto index =
+            backward ? snapshot.lastIndexOf(text, from, caseSensitivity) : snapshot.indexOf(text, from, caseSensitivity);
+        if (index == -1 || !(options & TextDocument::FindWholeWords)
+            || Utils::isWholeWord(snapshot, index, index + text.size()))
+            return index;
+        from = backward ? index - 1 : index + 1;
+    }
+    return -1;
+}
+
+// Creates the regexp used to search `regexp` with the given options.
+// The regexps are cached, as scripts are usually searching the same ones over and over, and compiling them is costly.
+static QRegularExpression findRegularExpression(QString regexp, int options)
+{
+    if (options & TextDocument::FindWholeWords) {
+        if (!regexp.startsWith("\\b"))
+            regexp = "\\b" + regexp;
+        if (!regexp.endsWith("\\b"))
+            regexp += "\\b";
+    }
+    const auto patternOptions = (options & (TextDocument::FindCaseSensitively | TextDocument::PreserveCase))
+        ? QRegularExpression::NoPatternOption
+        : QRegularExpression::CaseInsensitiveOption;
+
+    static QHash<std::pair<QString, int>, QRegularExpression> cache;
+    const auto key = std::make_pair(regexp, static_cast<int>(patternOptions));
+    if (auto it = cache.constFind(key); it != cache.cend())
+        return *it;
+
+    // Keep the cache small, scripts are only using a handful of different regexps.
+    if (cache.size() >= 64)
+        cache.clear();
+    QRegularExpression expression(regexp, patternOptions);
+    expression.optimize();
+    cache.insert(key, expression);
+    return expression;
+}
+
 /*!
  * \qmltype TextDocument
  * \brief Document object for text files.
@@ -129,26 +189,58 @@ TextDocument::TextDocument(QObject *parent)
 
 TextDocument::~TextDocument()
 {
-    delete m_document;
+    delete m_textEdit;
 }
 
 TextDocument::TextDocument(Type type, QObject *parent)
     : Document(type, parent)
-    , m_document(new TextEditor)
-{
-    m_document->hide();
-    connect(m_document, &QPlainTextEdit::textChanged, this, &TextDocument::textChanged);
-    connect(m_document, &QPlainTextEdit::selectionChanged, this, &TextDocument::selectionChanged);
-    connect(m_document, &QPlainTextEdit::cursorPositionChanged, this, &TextDocument::positionChanged);
-    connect(m_document->document(), &QTextDocument::contentsChange, this, [this]() {
+    , m_document(new QTextDocument(this))
+    , m_markRegistry(std::make_shared<MarkRegistry>())
+    , m_lineIndex(std::make_unique<LineIndex>(m_document))
+{
+    // Same layout as the one used by QPlainTextEdit, so the editor can be created later on the same document.
+    m_document->setDocumentLayout(new QPlainTextDocumentLayout(m_document));
+    m_textCursor = QTextCursor(m_document);
+
+    // Update the marks, the line index and the text snapshot first, so they are up to date for anyone else reacting
+    // to the change.
+    connect(m_document, &QTextDocument::contentsChange, this, [this](int from, int charsRemoved, int charsAdded) {
+        resetSnapshots();
+        m_lineIndex->update(from, charsRemoved, charsAdded);
+        if (!m_splitChange) {
+            updatePositions(from, charsRemoved, charsAdded);
+            return;
+        }
+        // QTextDocument may report a larger change than the one done, when it spans several blocks: the text around it
+        // is then reported as removed and added again, unchanged, so the individual changes are still valid.
+        const auto change = m_splitChange->change;
+        if (from <= change.position && change.position + change.charsRemoved <= from + charsRemoved
+            && charsAdded - charsRemoved == change.charsAdded - change.charsRemoved) {
+            for (const auto &splitChange : m_splitChange->changes)
+                updatePositions(splitChange.position, splitChange.charsRemoved, splitChange.charsAdded);
+        } else {
+            spdlog::warn("TextDocument::applyReplacements - unexpected change ({}, {}, {}) instead of ({}, {}, {}), "
+                         "the marks inside are moved to its start",
+                         from, charsRemoved, charsAdded, change.position, change.charsRemoved, change.charsAdded);
+            updatePositions(from, charsRemoved, charsAdded);
+        }
+        m_splitChange.reset();
+    });
+    connect(m_document, &QTextDocument::contentsChange, this, &TextDocument::changeContent);
+    connect(m_document, &QTextDocument::contentsChanged, this, &TextDocument::textChanged);
+    connect(m_document, &QTextDocument::contentsChange, this, [this]() {
         setHasChanged(true);
     });
-    m_document->installEventFilter(this);
+    // Edits done elsewhere in the document move the cursor, the editor (if any) takes care of it otherwise.
+    connect(m_document, &QTextDocument::cursorPositionChanged, this, [this](const QTextCursor &cursor) {
+        if (!m_textEdit && cursor.isCopyOf(m_textCursor))
+            updateCursorState();
+    });
 }
 
 bool TextDocument::eventFilter(QObject *watched, QEvent *event)
 {
-    Q_ASSERT(watched == m_document);
+    Q_ASSERT(watched == m_textEdit);
 
     if (event->type() == QEvent::KeyPress) {
         auto keyEvent = static_cast<QKeyEvent *>(event);
@@ -208,11 +300,11 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
         else if (keyEvent == QKeySequence::Paste)
             paste();
         else if (keyEvent == QKeySequence::Delete)
-            m_document->textCursor().hasSelection() ? deleteSelection() : deleteNextCharacter();
+            textCursor().hasSelection() ? deleteSelection() : deleteNextCharacter();
         else if (keyEvent == QKeySequence::Backspace
                  || (keyEvent->key() == Qt::Key_Backspace
                      && !(keyEvent->modifiers() & ~Qt::ShiftModifier))) // test is coming from QTextWidgetControl
-            m_document->textCursor().hasSelection() ? deleteSelection() : deletePreviousCharacter();
+            textCursor().hasSelection() ? deleteSelection() : deletePreviousCharacter();
         else if (keyEvent == QKeySequence::InsertParagraphSeparator)
             insert("\n");
         else if (keyEvent == QKeySequence::InsertLineSeparator)
@@ -226,7 +318,7 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
         else if (keyEvent == QKeySequence::SelectAll)
             selectAll();
         else if (!keyEvent->text().isEmpty()) {
-            auto control = m_document->findChild<QWidgetTextControl *>();
+            auto control = m_textEdit->findChild<QWidgetTextControl *>();
             if (control->isAcceptableInput(keyEvent))
                 insert(keyEvent->text());
         }
@@ -275,9 +367,11 @@ bool TextDocument::doLoad(const QString &fileName)
     QTextStream stream(data);
     const QString text = stream.readAll();
 
-    QSignalBlocker sb(m_document->document());
+    QSignalBlocker sb(m_document);
     // This will replace '\r\n' with '\n'
-    m_document->setPlainText(text);
+    setPlainText(text);
+    resetSnapshots();
+    m_lineIndex->invalidate();
     setHasChanged(false);
 
     return true;
@@ -307,39 +401,39 @@ void TextDocument::detectFormat(const QByteArray &data)
 int TextDocument::column() const
 {
     LOG("TextDocument::column");
-    const QTextCursor cursor = m_document->textCursor();
+    const QTextCursor cursor = textCursor();
     LOG_RETURN("column", cursor.positionInBlock() + 1);
 }
 
 int TextDocument::line() const
 {
     LOG("TextDocument::line");
-    const QTextCursor cursor = m_document->textCursor();
+    const QTextCursor cursor = textCursor();
     LOG_RETURN("line", cursor.blockNumber() + 1);
 }
 
 int TextDocument::lineCount() const
 {
     LOG("TextDocument::lineCount");
-    return m_document->document()->lineCount();
+    return m_document->lineCount();
 }
 
 int TextDocument::position() const
 {
     LOG("TextDocument::position");
-    LOG_RETURN("pos", m_document->textCursor().position());
+    LOG_RETURN("pos", textCursor().position());
 }
 
 int TextDocument::selectionStart() const
 {
     LOG("TextDocument::selectionStart");
-    LOG_RETURN("pos", m_document->textCursor().selectionStart());
+    LOG_RETURN("pos", textCursor().selectionStart());
 }
 
 int TextDocument::selectionEnd() const
 {
     LOG("TextDocument::selectionEnd");
-    LOG_RETURN("pos", m_document->textCursor().selectionEnd());
+    LOG_RETURN("pos", textCursor().selectionEnd());
 }
 
 void TextDocument::setPosition(int newPosition)
@@ -348,29 +442,76 @@ void TextDocument::setPosition(int newPosition)
 
     if (position() == newPosition)
         return;
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(newPosition);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
     emit positionChanged();
 }
 
 void TextDocument::convertPosition(int pos, int *line, int *column) const
 {
     Q_ASSERT(line && column);
-    const QTextBlock block = m_document->document()->findBlock(pos);
-    if (!block.isValid()) {
+    const int lineIndex = m_lineIndex->lineAt(pos);
+    if (lineIndex == -1) {
         (*line) = -1;
         (*column) = -1;
     } else {
         // line and column are both 1-based
-        (*line) = block.blockNumber() + 1;
-        (*column) = pos - block.position() + 1;
+        (*line) = lineIndex + 1;
+        (*column) = pos - m_lineIndex->lineStart(lineIndex) + 1;
+    }
+}
+
+const std::shared_ptr<MarkRegistry> &TextDocument::markRegistry() const
+{
+    return m_markRegistry;
+}
+
+/**
+ * \brief Returns the index of the line start positions, to convert positions without logging anything
+ */
+const LineIndex &TextDocument::lineIndex() const
+{
+    return *m_lineIndex;
+}
+
+const QString &TextDocument::textSnapshot() const
+{
+    if (!m_textSnapshot)
+        m_textSnapshot = m_document->toPlainText();
+    return *m_textSnapshot;
+}
+
+const QString &TextDocument::rawTextSnapshot() const
+{
+    if (!m_rawTextSnapshot)
+        m_rawTextSnapshot = m_document->toRawText();
+    return *m_rawTextSnapshot;
+}
+
+// Same text as the one searched by QTextDocument::find: the raw text, where the blocks are separated by
+// QChar::ParagraphSeparator, and the non-breaking spaces are searched as spaces.
+// The positions are the same as in the document.
+const QString &TextDocument::searchSnapshot() const
+{
+    if (!m_searchSnapshot) {
+        m_searchSnapshot = rawTextSnapshot();
+        if (m_searchSnapshot->contains(QChar::Nbsp))
+            m_searchSnapshot->replace(QChar::Nbsp, u' ');
     }
+    return *m_searchSnapshot;
+}
+
+void TextDocument::resetSnapshots()
+{
+    m_textSnapshot.reset();
+    m_rawTextSnapshot.reset();
+    m_searchSnapshot.reset();
 }
 
 int TextDocument::position(QTextCursor::MoveOperation operation, int pos) const
 {
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
 
     if (pos != -1)
         cursor.setPosition(pos);
@@ -415,31 +556,59 @@ int TextDocument::columnAtPosition(int position)
 int TextDocument::positionAt(int line, int column)
 {
     LOG("TextDocument::positionAt", LOG_ARG("line", line), LOG_ARG("column", column));
-    const QTextBlock block = m_document->document()->findBlockByLineNumber(line - 1);
-    if (!block.isValid()) {
+    const int start = m_lineIndex->lineStart(line - 1);
+    if (start == -1) {
         return -1;
     } else {
-        return block.position() + column - 1;
+        return start + column - 1;
     }
 }
 
+/*!
+ * \qmlmethod array<object> TextDocument::positionsToLineColumns(array<int> positions)
+ * Returns the line and column numbers of all the given text cursor `positions`, as a list of objects with `line` and
+ * `column` properties. Both are -1 if the position is invalid.
+ *
+ * This is faster than calling `lineAtPosition` and `columnAtPosition` for each position, especially if the positions
+ * are sorted.
+ *
+ * ```js
+ * let [start, end] = document.positionsToLineColumns([range.start, range.end]);
+ * ```
+ */
+QVariantList TextDocument::positionsToLineColumns(const QList<int> &positions)
+{
+    LOG("TextDocument::positionsToLineColumns");
+
+    QVariantList result;
+    result.reserve(positions.size());
+    int line = -1;
+    for (const auto position : positions) {
+        line = m_lineIndex->lineAt(position, line);
+        // line and column are both 1-based
+        const int column = line == -1 ? -1 : position - m_lineIndex->lineStart(line) + 1;
+        result.push_back(QVariantMap {{"line", line == -1 ? -1 : line + 1}, {"column", column}});
+    }
+    return result;
+}
+
 QString TextDocument::text() const
 {
     LOG("TextDocument::text");
-    LOG_RETURN("text", m_document->toPlainText());
+    LOG_RETURN("text", textSnapshot());
 }
 
 void TextDocument::setText(const QString &newText)
 {
     LOG("TextDocument::text", LOG_ARG("text", newText));
 
-    m_document->setPlainText(newText);
+    setPlainText(newText);
 }
 
 QString TextDocument::currentLine() const
 {
     LOG("TextDocument::currentLine");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfLine);
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
     LOG_RETURN("text", cursor.selectedText());
@@ -448,7 +617,7 @@ QString TextDocument::currentLine() const
 QString TextDocument::currentWord() const
 {
     LOG("TextDocument::currentWord");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfWord);
     cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
     LOG_RETURN("text", cursor.selectedText());
@@ -458,7 +627,7 @@ QString TextDocument::selectedText() const
 {
     LOG("TextDocument::selectedText");
     // Replace \u2029 with \n
-    const QString text = m_document->textCursor().selectedText().replace(QChar(8233), "\n");
+    const QString text = textCursor().selectedText().replace(QChar(8233), "\n");
     LOG_RETURN("text", text);
 }
 
@@ -472,11 +641,86 @@ bool TextDocument::hasUtf8Bom() const
     return m_utf8Bom;
 }
 
+/**
+ * \brief Returns the editor used to display the document
+ *
+ * The editor is only needed by the user interface, so it is created on the first call. Until then, the document is
+ * edited without any widget, which is the case when running a script from the command line or in the tests.
+ */
 QPlainTextEdit *TextDocument::textEdit() const
+{
+    if (!m_textEdit) {
+        auto self = const_cast<TextDocument *>(this);
+        auto textEdit = new TextEditor;
+        textEdit->hide();
+        textEdit->setDocument(m_document);
+        textEdit->setTextCursor(m_textCursor);
+        connect(textEdit, &QPlainTextEdit::selectionChanged, self, &TextDocument::selectionChanged);
+        connect(textEdit, &QPlainTextEdit::cursorPositionChanged, self, &TextDocument::positionChanged);
+        textEdit->installEventFilter(self);
+        m_textEdit = textEdit;
+    }
+    return m_textEdit;
+}
+
+/**
+ * \brief Returns the underlying text document
+ */
+QTextDocument *TextDocument::document() const
 {
     return m_document;
 }
 
+/**
+ * \brief Returns the current text cursor, from the editor if it has been created
+ */
+QTextCursor TextDocument::textCursor() const
+{
+    return m_textEdit ? m_textEdit->textCursor() : m_textCursor;
+}
+
+/**
+ * \brief Sets the current text cursor, in the editor if it has been created
+ */
+void TextDocument::setTextCursor(const QTextCursor &cursor)
+{
+    if (m_textEdit) {
+        m_textEdit->setTextCursor(cursor);
+        return;
+    }
+    m_textCursor = cursor;
+    updateCursorState();
+}
+
+// Emits the position and selection signals when there's no editor to do it, the same way the editor does.
+void TextDocument::updateCursorState()
+{
+    const int position = m_textCursor.position();
+    const int anchor = m_textCursor.anchor();
+    if (position == m_cursorPosition && anchor == m_cursorAnchor)
+        return;
+
+    const bool hadSelection = m_cursorPosition != m_cursorAnchor;
+    const bool moved = position != m_cursorPosition;
+    m_cursorPosition = position;
+    m_cursorAnchor = anchor;
+    if (hadSelection || m_textCursor.hasSelection())
+        emit selectionChanged();
+    if (moved)
+        emit positionChanged();
+}
+
+void TextDocument::setPlainText(const QString &text)
+{
+    if (m_textEdit) {
+        m_textEdit->setPlainText(text);
+        return;
+    }
+    // Like the editor, this clears the undo stack and moves the cursor at the start of the document
+    m_document->setPlainText(text);
+    setTextCursor(QTextCursor(m_document));
+}
+
 /**
  * \brief Returns the string when pressing on the tab key
  */
@@ -496,7 +740,12 @@ void TextDocument::undo(int count)
 {
     LOG_AND_MERGE("TextDocument::undo", count);
     while (count != 0) {
-        m_document->undo();
+        if (m_textEdit) {
+            m_textEdit->undo();
+        } else {
+            m_document->undo(&m_textCursor);
+            updateCursorState();
+        }
         --count;
     }
 }
@@ -509,16 +758,112 @@ void TextDocument::redo(int count)
 {
     LOG_AND_MERGE("TextDocument::redo", count);
     while (count != 0) {
-        m_document->redo();
+        if (m_textEdit) {
+            m_textEdit->redo();
+        } else {
+            m_document->redo(&m_textCursor);
+            updateCursorState();
+        }
         --count;
     }
 }
 
+/*!
+ * \qmlmethod TextDocument::beginEdit()
+ * Starts a batch of edits, ended by a call to `endEdit()`.
+ *
+ * During a batch, all the changes of the text are merged into one: anything derived from the text (the syntax tree,
+ * the language server, the excluded macros...) is only updated once when the batch ends, instead of after each edit.
+ * Marks are still kept up to date after each edit.
+ *
+ * Batches can be nested, only the outermost `endEdit()` ends the batch.
+ */
+void TextDocument::beginEdit()
+{
+    LOG("TextDocument::beginEdit");
+    ++m_editLevel;
+}
+
+/*!
+ * \qmlmethod TextDocument::endEdit()
+ * Ends a batch of edits started with `beginEdit()`.
+ */
+void TextDocument::endEdit()
+{
+    LOG("TextDocument::endEdit");
+    if (m_editLevel == 0) {
+        spdlog::error("TextDocument::endEdit - no batch edit started with TextDocument::beginEdit");
+        return;
+    }
+    if (--m_editLevel == 0)
+        flushContentsChange();
+}
+
+/*!
+ * \qmlmethod TextDocument::batch(function callback)
+ * Calls `callback` inside a batch of edits, see `beginEdit()`.
+ *
+ * ```js
+ * document.batch(function() {
+ *     document.replaceAll("foo", "bar");
+ *     document.insertAtLine("// Generated", 1);
+ * });
+ * ```
+ */
+void TextDocument::batch(const QJSValue &function)
+{
+    LOG("TextDocument::batch");
+    if (!function.isCallable()) {
+        spdlog::error("TextDocument::batch - the argument is not a function");
+        return;
+    }
+
+    beginEdit();
+    const auto result = function.call();
+    endEdit();
+    if (result.isError())
+        spdlog::error("TextDocument::batch - {}", result.toString());
+}
+
+void TextDocument::updatePositions(int position, int charsRemoved, int charsAdded)
+{
+    m_markRegistry->update(position, charsRemoved, charsAdded);
+    emit positionsChange(position, charsRemoved, charsAdded);
+}
+
+void TextDocument::changeContent(int position, int charsRemoved, int charsAdded)
+{
+    if (m_editLevel == 0) {
+        emit contentsChange(position, charsRemoved, charsAdded);
+        return;
+    }
+
+    if (!m_pendingChange) {
+        m_pendingChange = ContentsChange {position, charsRemoved, charsAdded};
+        return;
+    }
+
+    // Merge with the pending change, so it covers both: the pending change spans [position, position + charsAdded)
+    // in the current text, anything added around it is text that wasn't changed before.
+    auto &pending = *m_pendingChange;
+    const int start = std::min(pending.position, position);
+    const int end = std::max(pending.position + pending.charsAdded, position + charsRemoved);
+    pending.charsRemoved += (pending.position - start) + (end - pending.position - pending.charsAdded);
+    pending.charsAdded = end - start - charsRemoved + charsAdded;
+    pending.position = start;
+}
+
+void TextDocument::flushContentsChange()
+{
+    if (auto change = std::exchange(m_pendingChange, {}))
+        emit contentsChange(change->position, change->charsRemoved, change->charsAdded);
+}
+
 void TextDocument::movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode, int count)
 {
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.movePosition(operation, mode, count);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -531,21 +876,16 @@ void TextDocument::gotoLine(int line, int column)
 {
     LOG("TextDocument::gotoLine", LOG_ARG("line", line), LOG_ARG("column", column));
 
-    gotoLineInTextEdit(m_document, line, column);
-}
-
-void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column)
-{
     // Internally, columns are 0-based, while 1-based on the API
     column = column - 1;
-    const int blockNumber = qMin(line, textEdit->document()->blockCount()) - 1;
-    const QTextBlock &block = textEdit->document()->findBlockByNumber(blockNumber);
+    const int blockNumber = qMin(line, m_document->blockCount()) - 1;
+    const QTextBlock &block = m_document->findBlockByNumber(blockNumber);
     if (block.isValid()) {
         QTextCursor cursor(block);
         if (column > 0)
             cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, column);
 
-        textEdit->setTextCursor(cursor);
+        setTextCursor(cursor);
     }
 }
 
@@ -676,9 +1016,9 @@ void TextDocument::gotoEndOfDocument()
 void TextDocument::unselect()
 {
     LOG("TextDocument::unselect");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.clearSelection();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -688,7 +1028,7 @@ void TextDocument::unselect()
 bool TextDocument::hasSelection()
 {
     LOG("TextDocument::hasSelection");
-    return m_document->textCursor().hasSelection();
+    return textCursor().hasSelection();
 }
 
 /*!
@@ -698,7 +1038,9 @@ bool TextDocument::hasSelection()
 void TextDocument::selectAll()
 {
     LOG("TextDocument::selectAll");
-    m_document->selectAll();
+    QTextCursor cursor = textCursor();
+    cursor.select(QTextCursor::Document);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -708,9 +1050,9 @@ void TextDocument::selectAll()
 void TextDocument::selectTo(int pos)
 {
     LOG("TextDocument::selectTo", LOG_ARG("pos", pos));
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(pos, QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -820,10 +1162,10 @@ void TextDocument::selectNextWord(int count)
 void TextDocument::selectRegion(int from, int to)
 {
     LOG("TextDocument::selectRegion", from, to);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_document);
     cursor.setPosition(from, QTextCursor::MoveAnchor);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -843,7 +1185,10 @@ void TextDocument::selectRange(const RangeMark &range)
 void TextDocument::copy()
 {
     LOG("TextDocument::copy");
-    m_document->copy();
+    if (m_textEdit)
+        m_textEdit->copy();
+    else
+        QGuiApplication::clipboard()->setText(QTextDocumentFragment(textCursor()).toPlainText());
 }
 
 /*!
@@ -853,7 +1198,13 @@ void TextDocument::copy()
 void TextDocument::paste()
 {
     LOG("TextDocument::paste");
-    m_document->paste();
+    if (m_textEdit) {
+        m_textEdit->paste();
+    } else {
+        QTextCursor cursor = textCursor();
+        cursor.insertText(QGuiApplication::clipboard()->text());
+        setTextCursor(cursor);
+    }
 }
 
 /*!
@@ -863,7 +1214,13 @@ void TextDocument::paste()
 void TextDocument::cut()
 {
     LOG("TextDocument::cut");
-    m_document->cut();
+    if (m_textEdit) {
+        m_textEdit->cut();
+    } else {
+        QTextCursor cursor = textCursor();
+        QGuiApplication::clipboard()->setText(QTextDocumentFragment(cursor).toPlainText());
+        cursor.removeSelectedText();
+    }
 }
 
 /*!
@@ -873,10 +1230,10 @@ void TextDocument::cut()
 void TextDocument::remove(int length)
 {
     LOG("TextDocument::remove", length);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(cursor.position() + length, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -886,7 +1243,9 @@ void TextDocument::remove(int length)
 void TextDocument::insert(const QString &text)
 {
     LOG_AND_MERGE("TextDocument::insert", LOG_ARG("text", text));
-    m_document->insertPlainText(text);
+    QTextCursor cursor = textCursor();
+    cursor.insertText(text);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -900,10 +1259,10 @@ void TextDocument::insertAtLine(const QString &text, int line)
     else
         LOG("TextDocument::insertAtLine", LOG_ARG("text", text), LOG_ARG("line", line));
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (line > 0) {
-        const int blockNumber = qMin(line, m_document->document()->blockCount()) - 1;
-        const QTextBlock &block = m_document->document()->findBlockByNumber(blockNumber);
+        const int blockNumber = qMin(line, m_document->blockCount()) - 1;
+        const QTextBlock &block = m_document->findBlockByNumber(blockNumber);
         if (block.isValid())
             cursor = QTextCursor(block);
     }
@@ -917,7 +1276,7 @@ void TextDocument::insertAtLine(const QString &text, int line)
 void TextDocument::insertAtPosition(const QString &text, int pos)
 {
     LOG("TextDocument::insertAtPosition", text, pos);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(pos);
     cursor.beginEditBlock();
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
@@ -932,10 +1291,10 @@ void TextDocument::insertAtPosition(const QString &text, int pos)
 void TextDocument::replace(int length, const QString &text)
 {
     LOG("TextDocument::replace", length, text);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(cursor.position() + length, QTextCursor::KeepAnchor);
     cursor.insertText(text);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -945,11 +1304,11 @@ void TextDocument::replace(int length, const QString &text)
 void TextDocument::replace(int from, int to, const QString &text)
 {
     LOG("TextDocument::replace", from, to, text);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_document);
     cursor.setPosition(from);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
     cursor.insertText(text);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -973,10 +1332,10 @@ void TextDocument::deleteLine(int line)
     else
         LOG("TextDocument::deleteLine", LOG_ARG("line", line));
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (line > 0) {
-        const int blockNumber = qMin(line, m_document->document()->blockCount()) - 1;
-        const QTextBlock &block = m_document->document()->findBlockByNumber(blockNumber);
+        const int blockNumber = qMin(line, m_document->blockCount()) - 1;
+        const QTextBlock &block = m_document->findBlockByNumber(blockNumber);
         if (block.isValid())
             cursor = QTextCursor(block);
     } else {
@@ -993,7 +1352,7 @@ void TextDocument::deleteLine(int line)
 void TextDocument::deleteSelection()
 {
     LOG("TextDocument::deleteSelection");
-    m_document->textCursor().removeSelectedText();
+    textCursor().removeSelectedText();
 }
 
 /*!
@@ -1003,11 +1362,11 @@ void TextDocument::deleteSelection()
 void TextDocument::deleteRegion(int from, int to)
 {
     LOG("TextDocument::deleteRegion", from, to);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_document);
     cursor.setPosition(from);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1017,11 +1376,11 @@ void TextDocument::deleteRegion(int from, int to)
 void TextDocument::deleteRange(const RangeMark &range)
 {
     LOG("TextDocument::deleteRange", range);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_document);
     cursor.setPosition(range.start(), QTextCursor::MoveAnchor);
     cursor.setPosition(range.end(), QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1031,10 +1390,10 @@ void TextDocument::deleteRange(const RangeMark &range)
 void TextDocument::deleteEndOfLine()
 {
     LOG("TextDocument::deleteEndOfLine");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1044,10 +1403,10 @@ void TextDocument::deleteEndOfLine()
 void TextDocument::deleteStartOfLine()
 {
     LOG("TextDocument::deleteStartOfLine");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfLine, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1057,11 +1416,11 @@ void TextDocument::deleteStartOfLine()
 void TextDocument::deleteEndOfWord()
 {
     LOG("TextDocument::deleteEndOfWord");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (!cursor.hasSelection())
         cursor.movePosition(QTextCursor::NextWord, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1071,11 +1430,11 @@ void TextDocument::deleteEndOfWord()
 void TextDocument::deleteStartOfWord()
 {
     LOG("TextDocument::deleteStartOfWord");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (!cursor.hasSelection())
         cursor.movePosition(QTextCursor::PreviousWord, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1085,10 +1444,10 @@ void TextDocument::deleteStartOfWord()
 void TextDocument::deletePreviousCharacter(int count)
 {
     LOG_AND_MERGE("TextDocument::deletePreviousCharacter", count);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, count);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1098,10 +1457,10 @@ void TextDocument::deletePreviousCharacter(int count)
 void TextDocument::deleteNextCharacter(int count)
 {
     LOG_AND_MERGE("TextDocument::deleteNextCharacter", count);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, count);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1130,9 +1489,9 @@ void TextDocument::gotoMark(const Mark &mark)
         return;
     }
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(mark.position());
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1147,9 +1506,9 @@ void TextDocument::selectToMark(const Mark &mark)
         return;
     }
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(mark.position(), QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /**
@@ -1175,7 +1534,7 @@ Core::RangeMark TextDocument::createRangeMark(int from, int to)
 Core::RangeMark TextDocument::createRangeMark()
 {
     LOG("TextDocument::createRangeMark");
-    const auto cursor = m_document->textCursor();
+    const auto cursor = textCursor();
     const int start = cursor.selectionStart();
     const int end = cursor.selectionEnd();
 
@@ -1220,10 +1579,18 @@ bool TextDocument::find(const QString &text, int options)
     LOG("TextDocument::find", LOG_ARG("text", text), options);
     if (options & FindRegexp)
         return findRegexp(text, options);
-    else if (options & FindWholeWords)
-        return findRegexp(QRegularExpression::escape(text), options);
-    else
-        return m_document->find(text, static_cast<QTextDocument::FindFlags>(options));
+
+    // Same as QTextDocument::find, search from the end of the selection, or before its start when searching backward.
+    auto cursor = textCursor();
+    const int from = (options & FindBackward) ? cursor.selectionStart() - 1 : cursor.selectionEnd();
+    const auto index = findLiteral(searchSnapshot(), text, from, options);
+    if (index == -1)
+        return false;
+
+    cursor.setPosition(static_cast<int>(index));
+    cursor.setPosition(static_cast<int>(index + text.size()), QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+    return true;
 }
 
 /*!
@@ -1251,20 +1618,9 @@ auto TextDocument::selectRegexpMatch(
 {
     unselect();
 
-    if (options & FindWholeWords) {
-        if (!regexp.startsWith("\\b"))
-            regexp = "\\b" + regexp;
-        if (!regexp.endsWith("\\b"))
-            regexp += "\\b";
-    }
-
-    QRegularExpression expression(regexp);
-    if (options & (TextDocument::FindCaseSensitively | TextDocument::PreserveCase))
-        expression.setPatternOptions(expression.patternOptions() & ~QRegularExpression::CaseInsensitiveOption);
-    else
-        expression.setPatternOptions(expression.patternOptions() | QRegularExpression::CaseInsensitiveOption);
+    const auto expression = findRegularExpression(regexp, options);
 
-    const QTextCursor startCursor = m_document->textCursor();
+    const QTextCursor startCursor = textCursor();
     QTextBlock block = startCursor.block();
     int blockOffset = startCursor.positionInBlock();
 
@@ -1273,7 +1629,7 @@ auto TextDocument::selectRegexpMatch(
         if (found.has_value()) {
             const auto &[match, newCursor] = *found;
             if (selectionFunction(expression, match, newCursor)) {
-                m_document->setTextCursor(newCursor);
+                setTextCursor(newCursor);
                 return found;
             }
 
@@ -1349,22 +1705,21 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, int o
 {
     LOG("TextDocument::replaceOne", LOG_ARG("text", before), after, options);
 
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.movePosition(QTextCursor::Start);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 
     const bool usesRegExp = options & FindRegexp;
     const bool preserveCase = options & PreserveCase;
 
-    const auto regexp = Utils::createRegularExpression(before, options, usesRegExp);
     if (find(before, options)) {
         cursor.beginEditBlock();
-        const auto found = m_document->textCursor();
+        const auto found = textCursor();
         cursor.setPosition(found.selectionStart());
         cursor.setPosition(found.selectionEnd(), QTextCursor::KeepAnchor);
         QString afterText = after;
         if (usesRegExp) {
-            const QRegularExpressionMatch match = regexp.match(selectedText());
+            const QRegularExpressionMatch match = findRegularExpression(before, options).match(selectedText());
             afterText = Utils::expandRegExpReplacement(after, match.capturedTexts());
         } else if (preserveCase) {
             afterText = Utils::matchCaseReplacement(cursor.selectedText(), after);
@@ -1395,12 +1750,16 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, int o
  * or suffix, then the case of the prefix and/or suffix are preserved, and the other rules are applied on the rest of
  * the occurrence only.
  *
+ * All the matches are searched first, then replaced in one change: the marks and the cursor are moved as if each match
+ * was replaced one after the other. The cursor isn't moved to the last match: if it's inside a match, it's moved to
+ * the start of its replacement, otherwise it stays at the same place in the text.
+ *
  * Returns the number of changes done in the document.
  */
 int TextDocument::replaceAll(const QString &before, const QString &after, int options /* = NoFindFlags */)
 {
     LOG("TextDocument::replaceAll", LOG_ARG("text", before), after, options);
-    return replaceAll(before, after, options, [](auto) {
+    return replaceAll(before, after, options, [](int, int) {
         return true;
     });
 }
@@ -1427,48 +1786,147 @@ int TextDocument::replaceAllInRange(const QString &before, const QString &after,
         return 0;
     }
 
-    return replaceAll(before, after, options, [&range](auto cursor) {
-        return range.start() <= cursor.selectionStart()
-            && cursor.selectionEnd()
-            <= range.end(); // Use <= here, as the selection may be equal to the range, both values are exclusive.
+    return replaceAll(before, after, options, [start = range.start(), end = range.end()](int matchStart, int matchEnd) {
+        // Use <= here, as the match may be equal to the range, both values are exclusive.
+        return start <= matchStart && matchEnd <= end;
     });
 }
 
 int TextDocument::replaceAll(const QString &before, const QString &after, int options,
-                             const std::function<bool(QTextCursor)> &filterAcceptsCursor)
+                             const std::function<bool(int, int)> &filterAcceptsMatch)
 {
+    if (before.isEmpty())
+        return 0;
+
     const bool backwards = options & FindBackward;
     const bool usesRegExp = options & FindRegexp;
     const bool preserveCase = options & PreserveCase;
 
-    int count = 0;
-    auto cursor = m_document->textCursor();
-    cursor.movePosition(backwards ? QTextCursor::End : QTextCursor::Start);
-    m_document->setTextCursor(cursor);
-    cursor.beginEditBlock();
+    // All the matches are searched in the text before any replacement, and applied at once afterward.
+    const QString text = searchSnapshot();
 
-    const auto regexp = Utils::createRegularExpression(before, options, usesRegExp);
-    while (find(before, options)) {
-        const auto found = m_document->textCursor();
-        cursor.setPosition(found.selectionStart());
-        cursor.setPosition(found.selectionEnd(), QTextCursor::KeepAnchor);
-        if (!filterAcceptsCursor(cursor)) {
-            // Result filtered, so do not replace.
-            continue;
-        }
+    std::vector<Replacement> replacements;
+    auto addReplacement = [&](int start, int length, const QRegularExpressionMatch *match) {
+        if (!filterAcceptsMatch(start, start + length))
+            return;
         QString afterText = after;
-        if (usesRegExp) {
-            QRegularExpressionMatch match = regexp.match(selectedText());
-            afterText = Utils::expandRegExpReplacement(after, match.capturedTexts());
-        } else if (preserveCase) {
-            afterText = Utils::matchCaseReplacement(cursor.selectedText(), after);
+        if (usesRegExp)
+            afterText = Utils::expandRegExpReplacement(after, match->capturedTexts());
+        else if (preserveCase)
+            afterText = Utils::matchCaseReplacement(text.mid(start, length), after);
+        replacements.push_back({start, length, afterText});
+    };
+
+    if (!usesRegExp) {
+        // Same as `find`, search the text without any regexp, the matches can't overlap.
+        const int length = static_cast<int>(before.size());
+        if (backwards) {
+            for (qsizetype from = text.size() - length; (from = findLiteral(text, before, from, options)) != -1;
+                 from -= length)
+                addReplacement(static_cast<int>(from), length, nullptr);
+            // The replacements are kept in the order of the text.
+            std::reverse(replacements.begin(), replacements.end());
+        } else {
+            for (qsizetype from = 0; (from = findLiteral(text, before, from, options)) != -1; from += length)
+                addReplacement(static_cast<int>(from), length, nullptr);
+        }
+    } else {
+        // Same as `findRegexp`, the regexp is matched block by block.
+        const auto expression = findRegularExpression(before, options);
+        if (!expression.isValid()) {
+            spdlog::error("TextDocument::replaceAll - invalid regexp {}: {}", before, expression.errorString());
+            return 0;
+        }
+
+        QRegularExpressionMatch match;
+        for (int lineStart = 0; lineStart <= text.size();) {
+            int lineEnd = text.indexOf(QChar::ParagraphSeparator, lineStart);
+            if (lineEnd == -1)
+                lineEnd = text.size();
+            const QString line = text.sliced(lineStart, lineEnd - lineStart);
+
+            if (backwards) {
+                // Matches are searched from the end of the line, and must end before the previous one starts.
+                const auto lineReplacementsStart = replacements.size();
+                int limit = line.size();
+                for (int from = line.size(); from >= 0; --from) {
+                    from = line.lastIndexOf(expression, from, &match);
+                    if (from == -1)
+                        break;
+                    if (from + match.capturedLength() <= limit) {
+                        addReplacement(lineStart + from, match.capturedLength(), &match);
+                        limit = from;
+                    }
+                }
+                // The replacements are kept in the order of the text.
+                std::reverse(replacements.begin() + lineReplacementsStart, replacements.end());
+            } else {
+                for (int from = 0; from <= line.size();) {
+                    from = line.indexOf(expression, from, &match);
+                    if (from == -1)
+                        break;
+                    addReplacement(lineStart + from, match.capturedLength(), &match);
+                    // Don't match the same empty string again.
+                    from += std::max(1, static_cast<int>(match.capturedLength()));
+                }
+            }
+            lineStart = lineEnd + 1;
         }
-        cursor.insertText(afterText);
-        ++count;
     }
 
-    cursor.endEditBlock();
-    return count;
+    applyReplacements(replacements);
+    return static_cast<int>(replacements.size());
+}
+
+// Replaces all the `replacements` in one change, so it's only one undo step and one contentsChange. The marks are
+// updated with each replacement instead, so the ones between two replacements don't move to the first one.
+void TextDocument::applyReplacements(const std::vector<Replacement> &replacements)
+{
+    if (replacements.empty())
+        return;
+
+    // The text between the replacements is kept as is, including the non-breaking spaces.
+    const QString text = rawTextSnapshot();
+
+    // Build the new text between the first and the last replacement.
+    const int from = replacements.front().start;
+    const int to = replacements.back().start + replacements.back().length;
+    QString newText;
+    std::vector<ContentsChange> changes;
+    changes.reserve(replacements.size());
+    int position = from;
+    int delta = 0;
+    for (const auto &replacement : replacements) {
+        newText += QStringView(text).sliced(position, replacement.start - position);
+        newText += replacement.text;
+        changes.push_back(
+            {replacement.start + delta, replacement.length, static_cast<int>(replacement.text.size())});
+        delta += static_cast<int>(replacement.text.size()) - replacement.length;
+        position = replacement.start + replacement.length;
+    }
+
+    // The text cursor would be moved to the end of the change if it's inside, it's moved like a mark instead.
+    const QTextCursor textCursor = this->textCursor();
+    int cursorPosition = textCursor.position();
+    int cursorAnchor = textCursor.anchor();
+    for (const auto &change : changes) {
+        Mark::updateMark(cursorPosition, change.position, change.charsRemoved, change.charsAdded);
+        Mark::updateMark(cursorAnchor, change.position, change.charsRemoved, change.charsAdded);
+    }
+
+    m_splitChange = SplitChange {{from, to - from, static_cast<int>(newText.size())}, std::move(changes)};
+    QTextCursor cursor(m_document);
+    cursor.setPosition(from);
+    cursor.setPosition(to, QTextCursor::KeepAnchor);
+    cursor.insertText(newText);
+    m_splitChange.reset();
+
+    cursor = this->textCursor();
+    if (cursor.position() != cursorPosition || cursor.anchor() != cursorAnchor) {
+        cursor.setPosition(cursorAnchor);
+        cursor.setPosition(cursorPosition, QTextCursor::KeepAnchor);
+        setTextCursor(cursor);
+    }
 }
 
 /*!
@@ -1482,7 +1940,7 @@ int TextDocument::replaceAll(const QString &before, const QString &after, int op
 int TextDocument::replaceAllRegexp(const QString &regexp, const QString &after, int options /* = NoFindFlags */)
 {
     LOG("TextDocument::replaceAllRegexp", LOG_ARG("text", regexp), after, options);
-    return replaceAllRegexp(regexp, after, options, [](auto) {
+    return replaceAllRegexp(regexp, after, options, [](int, int) {
         return true;
     });
 }
@@ -1510,17 +1968,77 @@ int TextDocument::replaceAllRegexpInRange(const QString &regexp, const QString &
         return 0;
     }
 
-    return replaceAllRegexp(regexp, after, options, [&range](auto cursor) {
-        return range.start() <= cursor.selectionStart()
-            && cursor.selectionEnd()
-            <= range.end(); // Use <= here, as the selection may be equal to the range, both values are exclusive.
+    return replaceAllRegexp(regexp, after, options, [start = range.start(), end = range.end()](int matchStart, int matchEnd) {
+        // Use <= here, as the match may be equal to the range, both values are exclusive.
+        return start <= matchStart && matchEnd <= end;
     });
 }
 
 int TextDocument::replaceAllRegexp(const QString &regexp, const QString &after, int options,
-                                   const std::function<bool(QTextCursor)> &filterAcceptsCursor)
+                                   const std::function<bool(int, int)> &filterAcceptsMatch)
 {
-    return replaceAll(regexp, after, options | FindRegexp, filterAcceptsCursor);
+    return replaceAll(regexp, after, options | FindRegexp, filterAcceptsMatch);
+}
+
+/*!
+ * \qmlmethod int TextDocument::replaceAllMany(object replacements, int options = TextDocument.NoFindFlags)
+ * Replaces all occurrences of the keys of `replacements` with their values, in one pass on the text. This is much
+ * faster than calling `replaceAll` for each pair when there are many of them. Options could be a combination of:
+ *
+ * - `TextDocument.FindCaseSensitively`: match case
+ * - `TextDocument.FindWholeWords`: match only complete words
+ * - `TextDocument.PreserveCase`: preserve case when replacing, see `replaceAll`
+ *
+ * If several keys match at the same position, the longest one is used. Like `replaceAll`, the search is only case
+ * sensitive with `TextDocument.FindCaseSensitively`, even when `TextDocument.PreserveCase` is used.
+ *
+ * ```js
+ * document.replaceAllMany({"CString": "QString", "CStringArray": "QStringList"},
+ *                         TextDocument.FindCaseSensitively | TextDocument.FindWholeWords);
+ * ```
+ *
+ * Returns the number of changes done in the document.
+ */
+int TextDocument::replaceAllMany(const QVariantMap &replacements, int options)
+{
+    LOG("TextDocument::replaceAllMany", replacements, options);
+    if (options & FindRegexp) {
+        spdlog::error("TextDocument::replaceAllMany - regexps are not supported");
+        return 0;
+    }
+
+    QStringList afters;
+    afters.reserve(replacements.size());
+    for (const auto &value : replacements)
+        afters.push_back(value.toString());
+    return replaceAllMany(createAhoCorasick(replacements.keys(), options), afters, options);
+}
+
+int TextDocument::replaceAllMany(const Utils::AhoCorasick &matcher, const QStringList &replacements, int options)
+{
+    Q_ASSERT(matcher.patterns().size() == replacements.size());
+
+    const QString text = searchSnapshot();
+    const auto matches = matcher.findAll(text);
+
+    std::vector<Replacement> textReplacements;
+    textReplacements.reserve(matches.size());
+    for (const auto &match : matches) {
+        QString afterText = replacements.at(match.pattern);
+        if (options & PreserveCase)
+            afterText = Utils::matchCaseReplacement(text.sliced(match.start, match.length), afterText);
+        textReplacements.push_back({static_cast<int>(match.start), static_cast<int>(match.length), afterText});
+    }
+    applyReplacements(textReplacements);
+    return static_cast<int>(textReplacements.size());
+}
+
+Utils::AhoCorasick createAhoCorasick(const QStringList &patterns, int options)
+{
+    // Same as replaceAll without regexp: only FindCaseSensitively makes the search case sensitive.
+    const auto caseSensitivity =
+        (options & TextDocument::FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    return Utils::AhoCorasick(patterns, caseSensitivity, options & TextDocument::FindWholeWords);
 }
 
 static int columnAt(const QString &text, int position, int tabSize)
@@ -1566,14 +2084,13 @@ static int indentOneLine(QTextCursor &cursor, int tabCount, const TabSettings &s
     return text.size() - oldSize;
 }
 
-void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount)
+QTextCursor indentText(QTextCursor cursor, int tabCount)
 {
     const auto settings = Core::Settings::instance()->value<Core::TabSettings>(Core::Settings::Tab);
 
-    QTextCursor cursor = textEdit->textCursor();
     const bool hasSelection = cursor.hasSelection();
-    const int lineStart = textEdit->document()->findBlock(cursor.selectionStart()).blockNumber();
-    const int lineEnd = textEdit->document()->findBlock(cursor.selectionEnd()).blockNumber();
+    const int lineStart = cursor.document()->findBlock(cursor.selectionStart()).blockNumber();
+    const int lineEnd = cursor.document()->findBlock(cursor.selectionEnd()).blockNumber();
 
     // Move the position to the beginning of the first line
     int startPosition = cursor.position();
@@ -1597,14 +2114,18 @@ void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount)
     } else {
         cursor.select(QTextCursor::LineUnderCursor);
         startPosition += indentOneLine(cursor, tabCount, settings);
-        const int finalLine = textEdit->document()->findBlock(startPosition).blockNumber();
-        if (finalLine != lineStart)
-            gotoLineInTextEdit(textEdit, lineStart + 1);
-        else
+        // If the line has been split, the cursor is kept where the indentation stopped
+        const int finalLine = cursor.document()->findBlock(startPosition).blockNumber();
+        if (finalLine == lineStart)
             cursor.setPosition(startPosition);
     }
     cursor.endEditBlock();
-    textEdit->setTextCursor(cursor);
+    return cursor;
+}
+
+void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount)
+{
+    textEdit->setTextCursor(indentText(textEdit->textCursor(), tabCount));
 }
 
 /*!
@@ -1615,7 +2136,7 @@ void TextDocument::indent(int count)
 {
     LOG_AND_MERGE("TextDocument::indent", count);
     while (count != 0) {
-        indentTextInTextEdit(m_document, 1);
+        setTextCursor(indentText(textCursor(), 1));
         --count;
     }
 }
@@ -1628,7 +2149,7 @@ void TextDocument::removeIndent(int count)
 {
     LOG_AND_MERGE("TextDocument::removeIndent", count);
     while (count != 0) {
-        indentTextInTextEdit(m_document, -1);
+        setTextCursor(indentText(textCursor(), -1));
         --count;
     }
 }
@@ -1650,7 +2171,7 @@ void TextDocument::setLineEnding(LineEnding newLineEnding)
 QString TextDocument::indentationAtPosition(int pos)
 {
     LOG("TextDocument::indentationAtPosition", pos);
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(pos);
     cursor.movePosition(QTextCursor::StartOfLine);
     const QString line = cursor.block().text();
@@ -14,16 +14,28 @@
 #include "mark.h"
 #include "rangemark.h"
 
+#include <QJSValue>
 #include <QPointer>
 #include <QRegularExpressionMatch>
 #include <QTextCursor>
 #include <QTextDocument>
+#include <QVariantMap>
+
+#include <memory>
+#include <optional>
+#include <vector>
 
 class QPlainTextEdit;
 
+namespace Utils {
+class AhoCorasick;
+}
+
 namespace Core {
 
 class RangeMark;
+class MarkRegistry;
+class LineIndex;
 
 class TextDocument : public Document
 {
@@ -88,9 +100,16 @@ public:
     bool hasUtf8Bom() const;
 
     QPlainTextEdit *textEdit() const;
+    QTextDocument *document() const;
+    QTextCursor textCursor() const;
+    void setTextCursor(const QTextCursor &cursor);
+    const LineIndex &lineIndex() const;
 
     QString tab() const;
 
+    // Same as replaceAllMany, with an automaton already built, `replacements` being in the order of its patterns.
+    int replaceAllMany(const Utils::AhoCorasick &matcher, const QStringList &replacements, int options);
+
 public slots:
     void setPosition(int newPosition);
     void setText(const QString &newText);
@@ -99,10 +118,16 @@ public slots:
     int lineAtPosition(int position);
     int columnAtPosition(int position);
     int positionAt(int line, int column);
+    QVariantList positionsToLineColumns(const QList<int> &positions);
 
     void undo(int count = 1);
     void redo(int count = 1);
 
+    // Batch edits
+    void beginEdit();
+    void endEdit();
+    void batch(const QJSValue &function);
+
     // Goto methods, to move around the document
     void gotoLine(int line, int column = 1);
     void gotoStartOfLine();
@@ -186,6 +211,7 @@ public slots:
     int replaceAllRegexpInRange(const QString &regexp, const QString &after, const Core::RangeMark &range,
                                 int options = NoFindFlags);
     int replaceAllRegexp(const QString &regexp, const QString &after, int options = NoFindFlags);
+    int replaceAllMany(const QVariantMap &replacements, int options = NoFindFlags);
 
     // Indentation
     void indent(int count = 1);
@@ -197,6 +223,12 @@ signals:
     void textChanged();
     void selectionChanged();
     void lineEndingChanged();
+    // Same as QTextDocument::contentsChange, but only emitted once for all the changes done between beginEdit() and
+    // endEdit(). Anything derived from the text (syntax tree, LSP...) should be updated using this signal.
+    void contentsChange(int position, int charsRemoved, int charsAdded);
+    // Emitted for every change of the text, even inside a batch edit. A replacement of all the matches done in one edit
+    // is reported as one change per match: positions kept outside of marks should be updated using this signal.
+    void positionsChange(int position, int charsRemoved, int charsAdded);
 
 protected:
     explicit TextDocument(Type type, QObject *parent = nullptr);
@@ -205,16 +237,46 @@ protected:
     bool doLoad(const QString &fileName) override;
 
     friend MarkPrivate;
+    friend RangeMarkPrivate;
     void convertPosition(int pos, int *line, int *column) const;
+    const std::shared_ptr<MarkRegistry> &markRegistry() const;
     int position(QTextCursor::MoveOperation operation, int pos) const;
+    // Emits the pending contentsChange of the current batch edit now, if any.
+    void flushContentsChange();
 
+    // The filter is called with the start and end positions of each match, before any replacement is done.
     int replaceAll(const QString &before, const QString &after, int options,
-                   const std::function<bool(QTextCursor)> &filterAcceptsCursor);
+                   const std::function<bool(int, int)> &filterAcceptsMatch);
     int replaceAllRegexp(const QString &regexp, const QString &after, int options,
-                         const std::function<bool(QTextCursor)> &filterAcceptsCursor);
+                         const std::function<bool(int, int)> &filterAcceptsMatch);
 
 private:
+    struct ContentsChange
+    {
+        int position = 0;
+        int charsRemoved = 0;
+        int charsAdded = 0;
+
+        bool operator==(const ContentsChange &other) const = default;
+    };
+
+    struct Replacement
+    {
+        int start;
+        int length;
+        QString text;
+    };
+
     void detectFormat(const QByteArray &data);
+    void updatePositions(int position, int charsRemoved, int charsAdded);
+    void changeContent(int position, int charsRemoved, int charsAdded);
+    void applyReplacements(const std::vector<Replacement> &replacements);
+    void setPlainText(const QString &text);
+    void updateCursorState();
+    const QString &textSnapshot() const;
+    const QString &rawTextSnapshot() const;
+    const QString &searchSnapshot() const;
+    void resetSnapshots();
 
     void movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode = QTextCursor::MoveAnchor,
                       int count = 1);
@@ -226,11 +288,36 @@ private:
                 return true;
             }) -> std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>;
 
-    // TODO: use a QTextDocument maybe, to avoid creating a widget
-    // The QPlainTextEdit has a nicer API, so it's slightly easier with that now
-    QPointer<QPlainTextEdit> m_document;
+    QTextDocument *m_document = nullptr;
+    // Created on demand by textEdit(), the cursor is the one of the editor once it exists.
+    mutable QPointer<QPlainTextEdit> m_textEdit;
+    QTextCursor m_textCursor;
+    // Last cursor state notified, when there's no editor.
+    int m_cursorPosition = 0;
+    int m_cursorAnchor = 0;
+    // Positions of all the marks of the document, shared with the marks so they can tell if it's gone.
+    std::shared_ptr<MarkRegistry> m_markRegistry;
+    // Start positions of the lines, to convert positions to lines and columns.
+    std::unique_ptr<LineIndex> m_lineIndex;
+    // Plain text of the document, kept until the next change, so it isn't copied again each time it's needed.
+    mutable std::optional<QString> m_textSnapshot;
+    // Same for the raw text, and the text searched by find and replaceAll (see searchSnapshot).
+    mutable std::optional<QString> m_rawTextSnapshot;
+    mutable std::optional<QString> m_searchSnapshot;
     LineEnding m_lineEnding = NativeLineEnding;
     bool m_utf8Bom = false;
+
+    // Nesting level of beginEdit/endEdit, and the changes done so far merged into one.
+    int m_editLevel = 0;
+    std::optional<ContentsChange> m_pendingChange;
+
+    // Set by applyReplacements, the individual changes used to update the marks instead of the change done in the document.
+    struct SplitChange
+    {
+        ContentsChange change;
+        std::vector<ContentsChange> changes;
+    };
+    std::optional<SplitChange> m_splitChange;
 };
 
 } // namespace Core
@@ -10,9 +10,11 @@
 
 #pragma once
 
+#include "utils/aho_corasick.h"
 #include "utils/json.h"
 
 class QPlainTextEdit;
+class QTextCursor;
 
 namespace Core {
 
@@ -25,7 +27,11 @@ struct TabSettings
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(TabSettings, insertSpaces, tabSize);
 
+// Indents the lines of the cursor `tabCount` times (or removes the indentation if negative), returns the new cursor
+QTextCursor indentText(QTextCursor cursor, int tabCount);
 void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount);
-void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column = 1);
+
+// Creates the automaton used by replaceAllMany, for the given TextDocument::FindFlags
+Utils::AhoCorasick createAhoCorasick(const QStringList &patterns, int options);
 
 } // namespace Core
@@ -0,0 +1,153 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "tracer.h"
+#include "utils/json.h"
+#include "utils/log.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Core {
+
+namespace {
+
+struct Event
+{
+    const char *name = nullptr;
+    // Timestamps in microseconds since the tracer started, end is -1 until the call is done
+    double begin = 0;
+    double end = -1;
+    int depth = 0;
+    QString document;
+    QString arguments;
+};
+
+struct ThreadBuffer
+{
+    int threadId = 0;
+    int depth = 0;
+    QString document;
+    std::vector<Event> events;
+    bool isFull = false;
+};
+
+// The buffers are owned here, so they are still available when saving, even if their thread is gone.
+// The mutex is only used when a thread records its first call.
+std::mutex buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+thread_local ThreadBuffer *currentBuffer = nullptr;
+
+QElapsedTimer timer;
+
+ThreadBuffer &threadBuffer()
+{
+    if (!currentBuffer) {
+        std::lock_guard lock(buffersMutex);
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        currentBuffer = buffers.back().get();
+        currentBuffer->threadId = static_cast<int>(buffers.size());
+    }
+    return *currentBuffer;
+}
+
+double now()
+{
+    return timer.nsecsElapsed() / 1000.0;
+}
+
+} // namespace
+
+void Tracer::start()
+{
+    timer.start();
+    m_enabled = true;
+}
+
+void Tracer::stop()
+{
+    m_enabled = false;
+}
+
+void Tracer::setDocumentName(const QString &name)
+{
+    threadBuffer().document = name;
+}
+
+bool Tracer::save(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        spdlog::error("Tracer::save - can't save the trace to {}: {}", fileName, file.errorString());
+        return false;
+    }
+
+    const auto pid = QCoreApplication::applicationPid();
+    const double end = now();
+
+    // Written event by event, as there could be millions of them
+    file.write("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+    std::lock_guard lock(buffersMutex);
+    for (const auto &buffer : buffers) {
+        for (const auto &event : buffer->events) {
+            nlohmann::json args {{"depth", event.depth}};
+            if (!event.document.isEmpty())
+                args["document"] = event.document;
+            if (!event.arguments.isEmpty())
+                args["arguments"] = event.arguments;
+            // Complete events: the nesting is deduced from the timestamps
+            const nlohmann::json json {{"name", event.name},
+                                       {"cat", "api"},
+                                       {"ph", "X"},
+                                       {"ts", event.begin},
+                                       {"dur", (event.end < 0 ? end : event.end) - event.begin},
+                                       {"pid", pid},
+                                       {"tid", buffer->threadId},
+                                       {"args", args}};
+            if (!first)
+                file.write(",\n");
+            first = false;
+            file.write(json.dump().c_str());
+        }
+    }
+    file.write("\n]}\n");
+    return true;
+}
+
+int Tracer::beginEvent(const char *name, QString arguments)
+{
+    auto &buffer = threadBuffer();
+    if (buffer.events.size() >= MaxEvents) {
+        if (!buffer.isFull)
+            spdlog::warn("Tracer::beginEvent - more than {} calls, the next ones are not recorded", MaxEvents);
+        buffer.isFull = true;
+        return -1;
+    }
+    if (arguments.size() > MaxArgumentsSize)
+        arguments.truncate(MaxArgumentsSize);
+    buffer.events.push_back({name, now(), -1, buffer.depth, buffer.document, std::move(arguments)});
+    ++buffer.depth;
+    return static_cast<int>(buffer.events.size()) - 1;
+}
+
+void Tracer::endEvent(int event)
+{
+    auto &buffer = threadBuffer();
+    buffer.events[event].end = now();
+    --buffer.depth;
+}
+
+} // namespace Core
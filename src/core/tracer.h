@@ -0,0 +1,56 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+
+namespace Core {
+
+/**
+ * @brief Records the API calls done, with their duration, to find where the time is spent
+ *
+ * When enabled, every API call using LOG or LOG_AND_MERGE is recorded, including the calls done by other API calls,
+ * with the current document and a summary of its arguments. Each thread records its calls in its own buffer, so
+ * recording doesn't need any lock.
+ *
+ * The trace is saved in the Chrome trace event format, which can be loaded in Perfetto (https://ui.perfetto.dev) or
+ * in chrome://tracing.
+ */
+class Tracer
+{
+public:
+    static void start();
+    static void stop();
+    static bool isEnabled() { return m_enabled.load(std::memory_order_relaxed); }
+
+    // Sets the document recorded for the next calls of the current thread
+    static void setDocumentName(const QString &name);
+
+    // Saves all the calls recorded so far, in the Chrome trace event format
+    static bool save(const QString &fileName);
+
+    // Arguments longer than that are truncated, the trace is there to find the slow calls, not to replay them.
+    static constexpr qsizetype MaxArgumentsSize = 256;
+    // Calls recorded per thread, the next ones are dropped so a long run can't use all the memory.
+    static constexpr size_t MaxEvents = 1000000;
+
+    // Returns the event to pass to endEvent, or -1 if the call is not recorded.
+    // `name` must outlive the tracer (a string literal).
+    static int beginEvent(const char *name, QString arguments = {});
+    static void endEvent(int event);
+
+private:
+    inline static std::atomic<bool> m_enabled = false;
+};
+
+} // namespace Core
@@ -36,6 +36,13 @@ HistoryPanel::HistoryPanel(QWidget *parent)
         scrollTo(m_model->index(m_model->rowCount() - 1, 0));
     };
     connect(m_model, &QAbstractItemModel::rowsInserted, this, showLast);
+    // The oldest calls are removed when the history is full, keep the recording on the same calls
+    connect(m_model, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex &, int first, int last) {
+        if (m_startRow > last)
+            m_startRow -= last - first + 1;
+        else if (m_startRow >= first)
+            m_startRow = first;
+    });
 
     auto layout = new QHBoxLayout(m_toolBar);
     layout->setContentsMargins({});
@@ -33,6 +33,7 @@
 #include "logpanel.h"
 #include "optionsdialog.h"
 #include "palette.h"
+#include "profilerpanel.h"
 #include "qmlview.h"
 #include "qttsview.h"
 #include "qtuiview.h"
@@ -147,6 +148,8 @@ MainWindow::MainWindow(QWidget *parent)
     auto logPanel = new LogPanel(this);
     createDock(logPanel, Qt::BottomDockWidgetArea, logPanel->toolBar());
     createDock(m_historyPanel, Qt::BottomDockWidgetArea, m_historyPanel->toolBar());
+    auto profilerPanel = new ProfilerPanel(this);
+    createDock(profilerPanel, Qt::BottomDockWidgetArea, profilerPanel->toolBar());
     auto scriptDock = createDock(m_scriptPanel, Qt::LeftDockWidgetArea, m_scriptPanel->toolBar());
     auto scriptListDock = createDock(m_scriptlistpanel, Qt::BottomDockWidgetArea, m_scriptlistpanel->toolBar());
     scriptListDock->setAllowedAreas(Qt::AllDockWidgetAreas);
@@ -0,0 +1,71 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "profilerpanel.h"
+#include "core/profiler.h"
+#include "core/scriptmanager.h"
+#include "guisettings.h"
+
+#include <QCheckBox>
+#include <QHBoxLayout>
+#include <QToolButton>
+
+namespace Gui {
+
+ProfilerPanel::ProfilerPanel(QWidget *parent)
+    : QPlainTextEdit(parent)
+    , m_toolBar(new QWidget)
+{
+    setWindowTitle(tr("Profiler"));
+    setObjectName("ProfilerPanel");
+    setReadOnly(true);
+    setWordWrapMode(QTextOption::NoWrap);
+    GuiSettings::setupTextEdit(this);
+
+    // The report is updated each time a script is finished, it aggregates all the scripts run since the last clear
+    connect(Core::ScriptManager::instance(), &Core::ScriptManager::scriptFinished, this, &ProfilerPanel::updateReport);
+
+    // Setup titlebar
+    auto layout = new QHBoxLayout(m_toolBar);
+    layout->setContentsMargins({});
+
+    auto clearButton = new QToolButton(m_toolBar);
+    GuiSettings::setIcon(clearButton, ":/gui/delete-sweep.png");
+    clearButton->setToolTip(tr("Clear"));
+    clearButton->setAutoRaise(true);
+    layout->addWidget(clearButton);
+    connect(clearButton, &QToolButton::clicked, this, [this]() {
+        Core::Profiler::clear();
+        clear();
+    });
+
+    auto profileCheck = new QCheckBox(tr("Profile scripts"), m_toolBar);
+    profileCheck->setChecked(Core::Profiler::isEnabled());
+    layout->addWidget(profileCheck);
+    connect(profileCheck, &QCheckBox::toggled, this, [](bool checked) {
+        if (checked)
+            Core::Profiler::start();
+        else
+            Core::Profiler::stop();
+    });
+}
+
+QWidget *ProfilerPanel::toolBar() const
+{
+    return m_toolBar;
+}
+
+void ProfilerPanel::updateReport()
+{
+    if (Core::Profiler::isEnabled())
+        setPlainText(Core::Profiler::report());
+}
+
+} // namespace Gui
@@ -16,10 +16,12 @@
 
 namespace Gui {
 
-TreeSitterTreeModel::TreeNode::TreeNode(const treesitter::Node &node, const TreeNode *parent, bool enableUnnamed)
+TreeSitterTreeModel::TreeNode::TreeNode(const treesitter::Node &node, const TreeNode *parent, bool enableUnnamed,
+                                        const QString &fieldName)
     : m_parent(parent)
     , m_node(node)
     , m_enableUnnamed(enableUnnamed)
+    , m_fieldName(fieldName)
 {
 }
 
@@ -34,9 +36,11 @@ std::vector<std::unique_ptr<TreeSitterTreeModel::TreeNode>> &TreeSitterTreeModel
 {
 
     if (m_children.empty() && childCount() > 0) {
-        auto children = m_enableUnnamed ? m_node.children() : m_node.namedChildren();
-        for (const auto &child : children) {
-            m_children.emplace_back(new TreeNode(child, this, m_enableUnnamed));
+        const auto children = m_enableUnnamed ? m_node.childRange() : m_node.namedChildRange();
+        for (auto it = children.begin(); it != children.end(); ++it) {
+            const auto *fieldName = it.fieldName();
+            m_children.emplace_back(
+                new TreeNode(*it, this, m_enableUnnamed, fieldName ? QString(fieldName) : QString()));
         }
     }
 
@@ -58,20 +62,16 @@ const TreeSitterTreeModel::TreeNode *TreeSitterTreeModel::TreeNode::child(int ro
 
 QVariant TreeSitterTreeModel::TreeNode::data(int column) const
 {
-    auto fieldName = QString();
-    if (parent()) {
-        fieldName = parent()->m_node.fieldNameForChild(m_node);
-    }
     switch (column) {
     case 0:
-        if (fieldName.isEmpty()) {
+        if (m_fieldName.isEmpty()) {
             auto type = m_node.type();
             // Some anonymous nodes actually cover a newline, so we need to escape it.
             // This is usually for C preprocessor directives.
             type.replace("\n", "\\n");
             return type;
         } else {
-            return QString("%1: %2").arg(fieldName, m_node.type());
+            return QString("%1: %2").arg(m_fieldName, m_node.type());
         }
     case 1:
         return QString("[%1:%2](%3) - [%4:%5](%6)")
@@ -28,7 +28,8 @@ public:
     class TreeNode
     {
     public:
-        explicit TreeNode(const treesitter::Node &node, const TreeNode *parent, bool enableUnnamed);
+        explicit TreeNode(const treesitter::Node &node, const TreeNode *parent, bool enableUnnamed,
+                          const QString &fieldName = {});
 
         int childCount() const;
         const TreeNode *child(int row) const;
@@ -54,6 +55,8 @@ public:
         mutable std::vector<std::unique_ptr<TreeNode>> m_children;
         treesitter::Node m_node;
         bool m_enableUnnamed;
+        // Field name of the node in its parent, empty if there's none.
+        QString m_fieldName;
     };
 
     TreeSitterTreeModel(QObject *parent = nullptr);
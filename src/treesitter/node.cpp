@@ -11,7 +11,7 @@
 #include "node.h"
 #include "utils/log.h"
 
-#include <kdalgorithms.h>
+#include <ranges>
 
 namespace treesitter {
 
@@ -30,6 +30,32 @@ QString Node::type() const
     return QString(rawType());
 }
 
+Node::TypeId Node::typeId() const
+{
+    return ts_node_symbol(m_node);
+}
+
+const TSLanguage *Node::language() const
+{
+    return ts_tree_language(m_node.tree);
+}
+
+QList<Node::TypeId> Node::typeIdsForNames(const TSLanguage *language, const QStringList &names)
+{
+    QList<TypeId> result;
+    for (const auto &name : names) {
+        const auto utf8 = name.toUtf8();
+        for (const bool isNamed : {true, false}) {
+            // 0 is the id of the builtin "end" symbol, returned when there's no such type.
+            const auto id = ts_language_symbol_for_name(language, utf8.constData(), utf8.size(), isNamed);
+            if (id != 0 && !result.contains(id)) {
+                result.push_back(id);
+            }
+        }
+    }
+    return result;
+}
+
 uint32_t Node::namedChildCount() const
 {
     return ts_node_named_child_count(m_node);
@@ -142,6 +168,16 @@ QList<Node> Node::namedChildren() const
     return result;
 }
 
+Node::ChildRange Node::childRange() const
+{
+    return ChildRange(m_node, false);
+}
+
+Node::ChildRange Node::namedChildRange() const
+{
+    return ChildRange(m_node, true);
+}
+
 Node Node::nextSibling() const
 {
     return Node(ts_node_next_sibling(m_node));
@@ -208,25 +244,32 @@ bool Node::hasError() const
 }
 
 QString Node::textIn(const QString &source) const
+{
+    return textView(source).toString();
+}
+
+QStringView Node::textView(const QString &source) const
 {
     const auto start = this->startPosition();
     const auto end = this->endPosition();
 
-    return source.sliced(start, end - start);
+    return QStringView(source).sliced(start, end - start);
 }
 
 QString Node::textExcept(const QString &source, const QList<QString> &nodeTypes) const
 {
-    auto text = textIn(source);
+    return textExcept(source, typeIdsForNames(language(), nodeTypes));
+}
 
-    auto children = allChildrenOfType(nodeTypes);
-    // make sure to sort the children back-to-front, so that removing them in order
-    // doesn't mess up the ranges of the remaining children.
-    kdalgorithms::sort(children, [](const auto &left, const auto &right) {
-        return left.startPosition() > right.startPosition();
-    });
+QString Node::textExcept(const QString &source, const QList<TypeId> &nodeTypes) const
+{
+    auto text = textIn(source);
 
-    for (const auto &child : std::as_const(children)) {
+    QList<Node> children;
+    allChildrenOfType(nodeTypes, children);
+    // The children are found in document order, and don't overlap. Remove them back-to-front, so that
+    // removing them in order doesn't mess up the ranges of the remaining children.
+    for (const auto &child : std::as_const(children) | std::views::reverse) {
         const auto start = child.startPosition();
         const auto end = child.endPosition();
         text.remove(start - this->startPosition(), end - start);
@@ -235,22 +278,17 @@ QString Node::textExcept(const QString &source, const QList<QString> &nodeTypes)
     return text;
 }
 
-QList<Node> Node::allChildrenOfType(const QList<QString> &nodeTypes) const
+void Node::allChildrenOfType(const QList<TypeId> &nodeTypes, QList<Node> &result) const
 {
-    auto result = QList<Node>();
-
-    const auto allChildren = children();
-    for (const auto &child : allChildren) {
+    for (const auto &child : childRange()) {
         // break the recursion at the first node that is of the given type
         // That way we don't get overlapping child nodes.
-        if (kdalgorithms::contains(nodeTypes, child.type())) {
+        if (nodeTypes.contains(child.typeId())) {
             result.push_back(child);
         } else {
-            result.append(child.allChildrenOfType(nodeTypes));
+            child.allChildrenOfType(nodeTypes, result);
         }
     }
-
-    return result;
 }
 
 bool Node::operator==(const Node &other) const
@@ -268,4 +306,89 @@ Node Node::parent() const
     return Node(ts_node_parent(m_node));
 }
 
+// ----------------------- ChildIterator ------------------
+Node::ChildIterator::ChildIterator(const TSNode &parent, bool namedOnly)
+    : m_cursor(ts_tree_cursor_new(parent))
+    , m_namedOnly(namedOnly)
+    , m_atEnd(!ts_tree_cursor_goto_first_child(&m_cursor))
+{
+    skipUnnamed();
+}
+
+Node::ChildIterator::ChildIterator(ChildIterator &&other) noexcept
+    : m_cursor(other.m_cursor)
+    , m_namedOnly(other.m_namedOnly)
+    , m_atEnd(other.m_atEnd)
+    , m_ownsCursor(other.m_ownsCursor)
+{
+    other.m_ownsCursor = false;
+    other.m_atEnd = true;
+}
+
+Node::ChildIterator::~ChildIterator()
+{
+    if (m_ownsCursor) {
+        ts_tree_cursor_delete(&m_cursor);
+    }
+}
+
+Node::ChildIterator &Node::ChildIterator::operator=(ChildIterator &&other) noexcept
+{
+    std::swap(m_cursor, other.m_cursor);
+    std::swap(m_namedOnly, other.m_namedOnly);
+    std::swap(m_atEnd, other.m_atEnd);
+    std::swap(m_ownsCursor, other.m_ownsCursor);
+    return *this;
+}
+
+Node Node::ChildIterator::operator*() const
+{
+    return Node(ts_tree_cursor_current_node(&m_cursor));
+}
+
+Node::ChildIterator &Node::ChildIterator::operator++()
+{
+    m_atEnd = !ts_tree_cursor_goto_next_sibling(&m_cursor);
+    skipUnnamed();
+    return *this;
+}
+
+void Node::ChildIterator::operator++(int)
+{
+    ++*this;
+}
+
+bool Node::ChildIterator::operator==(Sentinel) const
+{
+    return m_atEnd;
+}
+
+const char *Node::ChildIterator::fieldName() const
+{
+    return ts_tree_cursor_current_field_name(&m_cursor);
+}
+
+void Node::ChildIterator::skipUnnamed()
+{
+    while (m_namedOnly && !m_atEnd && !ts_node_is_named(ts_tree_cursor_current_node(&m_cursor))) {
+        m_atEnd = !ts_tree_cursor_goto_next_sibling(&m_cursor);
+    }
+}
+
+Node::ChildRange::ChildRange(const TSNode &parent, bool namedOnly)
+    : m_parent(parent)
+    , m_namedOnly(namedOnly)
+{
+}
+
+Node::ChildIterator Node::ChildRange::begin() const
+{
+    return ChildIterator(m_parent, m_namedOnly);
+}
+
+Node::ChildIterator::Sentinel Node::ChildRange::end() const
+{
+    return {};
+}
+
 }
@@ -13,6 +13,8 @@
 #include <tree_sitter/api.h>
 
 #include <QString>
+#include <QStringList>
+#include <QStringView>
 #include <QVector>
 
 namespace treesitter {
@@ -22,6 +24,65 @@ using Point = TSPoint;
 class Node
 {
 public:
+    // Node types are identified by a symbol of the language, comparing them doesn't need the type names.
+    using TypeId = TSSymbol;
+
+    class ChildRange;
+
+    // Iterates over the children of a node with a TSTreeCursor, without creating a list of the children.
+    class ChildIterator
+    {
+    public:
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+
+        struct Sentinel
+        {
+        };
+
+        ChildIterator(const ChildIterator &) = delete;
+        ChildIterator(ChildIterator &&other) noexcept;
+        ~ChildIterator();
+
+        ChildIterator &operator=(const ChildIterator &) = delete;
+        ChildIterator &operator=(ChildIterator &&other) noexcept;
+
+        Node operator*() const;
+        ChildIterator &operator++();
+        void operator++(int);
+
+        bool operator==(Sentinel) const;
+
+        // This returns nullptr if the current child has no field name.
+        const char *fieldName() const;
+
+    private:
+        ChildIterator(const TSNode &parent, bool namedOnly);
+        void skipUnnamed();
+
+        TSTreeCursor m_cursor;
+        bool m_namedOnly;
+        bool m_atEnd;
+        bool m_ownsCursor = true;
+
+        friend class ChildRange;
+    };
+
+    class ChildRange
+    {
+    public:
+        ChildIterator begin() const;
+        ChildIterator::Sentinel end() const;
+
+    private:
+        ChildRange(const TSNode &parent, bool namedOnly);
+
+        TSNode m_parent;
+        bool m_namedOnly;
+
+        friend class Node;
+    };
+
     Node(const Node &) = default;
     Node(Node &&) = default;
 
@@ -30,6 +91,12 @@ public:
 
     QString type() const;
     const char *rawType() const;
+    TypeId typeId() const;
+    const TSLanguage *language() const;
+
+    // Ids of the node types with the given names in the language, see typeId.
+    // A name may be used by both a named and an anonymous node type, both are returned.
+    static QVector<TypeId> typeIdsForNames(const TSLanguage *language, const QStringList &names);
 
     uint32_t namedChildCount() const;
     Node namedChild(uint32_t index) const;
@@ -40,6 +107,10 @@ public:
     uint32_t childCount() const;
     QVector<Node> children() const;
 
+    // Prefer these to children() and namedChildren() when just iterating over the children.
+    ChildRange childRange() const;
+    ChildRange namedChildRange() const;
+
     Node nextSibling() const;
     Node previousSibling() const;
     Node nextNamedSibling() const;
@@ -59,7 +130,9 @@ public:
     bool hasError() const;
 
     QString textIn(const QString &source) const;
+    QStringView textView(const QString &source) const;
     QString textExcept(const QString &source, const QVector<QString> &nodeTypes) const;
+    QString textExcept(const QString &source, const QVector<TypeId> &nodeTypes) const;
 
     Node descendantForRange(uint32_t left, uint32_t right) const;
     Node parent() const;
@@ -69,7 +142,7 @@ public:
 private:
     Node(const TSNode &node);
 
-    QVector<Node> allChildrenOfType(const QVector<QString> &nodeTypes) const;
+    void allChildrenOfType(const QVector<TypeId> &nodeTypes, QVector<Node> &result) const;
 
     // TODO: make private again
 public:
@@ -58,11 +58,39 @@ std::optional<Tree> Parser::parseString(const QString &text, const Tree *old_tre
     return tree ? Tree(tree) : std::optional<Tree> {};
 }
 
+std::optional<Tree> Parser::parse(const TSInput &input, const Tree *old_tree) const
+{
+    Q_ASSERT(input.encoding == TSInputEncodingUTF16);
+    auto tree = ts_parser_parse(m_parser, old_tree ? old_tree->m_tree : nullptr, input);
+
+    return tree ? Tree(tree) : std::optional<Tree> {};
+}
+
 bool Parser::setIncludedRanges(const QList<Range> &ranges)
 {
     return ts_parser_set_included_ranges(m_parser, ranges.data(), ranges.size());
 }
 
+void Parser::setTimeout(std::chrono::microseconds timeout)
+{
+    ts_parser_set_timeout_micros(m_parser, static_cast<uint64_t>(timeout.count()));
+}
+
+std::chrono::microseconds Parser::timeout() const
+{
+    return std::chrono::microseconds(ts_parser_timeout_micros(m_parser));
+}
+
+void Parser::setCancellationFlag(const size_t *flag)
+{
+    ts_parser_set_cancellation_flag(m_parser, flag);
+}
+
+void Parser::reset()
+{
+    ts_parser_reset(m_parser);
+}
+
 const TSLanguage *Parser::language() const
 {
     return ts_parser_language(m_parser);
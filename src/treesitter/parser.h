@@ -12,6 +12,7 @@
 
 #include "core/document.h"
 #include <QString>
+#include <chrono>
 #include <tree_sitter/api.h>
 #include <vector>
 
@@ -39,6 +40,9 @@ public:
     void swap(Parser &other) noexcept;
 
     std::optional<Tree> parseString(const QString &text, const Tree *old_tree = nullptr) const;
+    // Parses the text read from the input, which must be UTF-16 encoded.
+    // This avoids having to copy the whole text into a single string first.
+    std::optional<Tree> parse(const TSInput &input, const Tree *old_tree = nullptr) const;
 
     /**
      * Parse only the given ranges.
@@ -55,6 +59,25 @@ public:
      */
     bool setIncludedRanges(const QList<Range> &ranges);
 
+    /**
+     * Stops parsing when it takes longer than `timeout`, the parse functions then return an empty optional.
+     * A timeout of 0 (the default) means there's no time limit.
+     */
+    void setTimeout(std::chrono::microseconds timeout);
+    std::chrono::microseconds timeout() const;
+
+    /**
+     * Stops parsing as soon as the value pointed to by `flag` is non-zero, the parse functions then return an empty
+     * optional. The flag is read atomically, so it can be set from another thread while parsing.
+     */
+    void setCancellationFlag(const size_t *flag);
+
+    /**
+     * Discards the state of a parse stopped by a timeout or a cancellation.
+     * Otherwise the next call to a parse function tries to resume it.
+     */
+    void reset();
+
     const TSLanguage *language() const;
 
     static TSLanguage *getLanguage(Core::Document::Type type);
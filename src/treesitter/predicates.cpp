@@ -11,70 +11,106 @@
 #include "predicates.h"
 
 #include "languages.h"
+#include "query_cache.h"
 
 #include "kdalgorithms.h"
 #include "utils/log.h"
 
 #include <ranges>
-#include <set>
 
 #include <QRegularExpression>
 
 namespace treesitter {
 
-QString QString_identity(const QString &string)
+static bool textEquals(QStringView left, QStringView right)
 {
-    return string;
+    return left == right;
 }
 
-QString QString_no_whitespace(const QString &string)
+// Same as comparing both texts with all whitespace removed, but without allocating.
+static bool textEqualsIgnoringWhitespace(QStringView left, QStringView right)
 {
-    auto simplified = string.simplified();
-    simplified.replace(" ", "");
-    return simplified;
+    auto leftIt = left.cbegin();
+    auto rightIt = right.cbegin();
+    while (true) {
+        while (leftIt != left.cend() && leftIt->isSpace())
+            ++leftIt;
+        while (rightIt != right.cend() && rightIt->isSpace())
+            ++rightIt;
+        if (leftIt == left.cend() || rightIt == right.cend())
+            return leftIt == left.cend() && rightIt == right.cend();
+        if (*leftIt != *rightIt)
+            return false;
+        ++leftIt;
+        ++rightIt;
+    }
+}
+
+static bool regexMatches(const QRegularExpression &regex, QStringView text)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+    return regex.matchView(text).hasMatch();
+#else
+    return regex.match(text).hasMatch();
+#endif
 }
 
-Predicates::Filters Predicates::filters()
+const Predicates::Filters &Predicates::filters()
 {
-    Predicates::Filters filters;
+    static const Predicates::Filters instance = [] {
+        Predicates::Filters filters;
 #define REGISTER_FILTER(NAME)                                                                                          \
     filters.filterFunctions[#NAME "?"] = &Predicates::filter_##NAME;                                                   \
     filters.checkFunctions[#NAME "?"] = &Predicates::checkFilter_##NAME
-
-    REGISTER_FILTER(eq);
-    REGISTER_FILTER(eq_except);
-    REGISTER_FILTER(like);
-    REGISTER_FILTER(like_except);
-    REGISTER_FILTER(match);
-    REGISTER_FILTER(in_message_map);
-    REGISTER_FILTER(not_is);
+#define REGISTER_FILTER_PREPARATION(NAME, PREPARATION)                                                                 \
+    filters.prepareFunctions[#NAME "?"] = &Predicates::PREPARATION
+
+        REGISTER_FILTER(eq);
+        REGISTER_FILTER(eq_except);
+        REGISTER_FILTER(like);
+        REGISTER_FILTER(like_except);
+        REGISTER_FILTER(match);
+        REGISTER_FILTER(in_message_map);
+        REGISTER_FILTER(not_is);
+
+        REGISTER_FILTER_PREPARATION(match, prepareFilter_match);
+        REGISTER_FILTER_PREPARATION(eq_except, prepareFilter_eq_except);
+        REGISTER_FILTER_PREPARATION(like_except, prepareFilter_eq_except);
+        REGISTER_FILTER_PREPARATION(not_is, prepareNodeTypes);
+#undef REGISTER_FILTER_PREPARATION
 #undef REGISTER_FILTER
 
-    return filters;
+        return filters;
+    }();
+    return instance;
 }
 
-Predicates::Commands Predicates::commands()
+const Predicates::Commands &Predicates::commands()
 {
-    Predicates::Commands commands;
+    static const Predicates::Commands instance = [] {
+        Predicates::Commands commands;
 
 #define REGISTER_COMMAND(NAME)                                                                                         \
     commands.commandFunctions[#NAME "!"] = &Predicates::command_##NAME;                                                \
     commands.checkFunctions[#NAME "!"] = &Predicates::checkCommand_##NAME;
 
-    REGISTER_COMMAND(exclude)
+        REGISTER_COMMAND(exclude)
+        commands.prepareFunctions["exclude!"] = &Predicates::prepareNodeTypes;
 #undef REGISTER_COMMAND
-    return commands;
+        return commands;
+    }();
+    return instance;
 }
 
 std::optional<QString> Predicates::checkPredicate(const Query::Predicate &predicate)
 {
-    const auto filters = Predicates::filters();
+    const auto &filters = Predicates::filters();
     auto it = filters.checkFunctions.find(predicate.name);
     if (it != filters.checkFunctions.cend()) {
         return it->second(predicate.arguments);
     }
 
-    const auto commands = Predicates::commands();
+    const auto &commands = Predicates::commands();
     it = commands.checkFunctions.find(predicate.name);
     if (it != commands.checkFunctions.cend()) {
         return it->second(predicate.arguments);
@@ -90,38 +126,71 @@ Predicates::Predicates(QString source)
 
 void Predicates::executeCommands(QueryMatch &match) const
 {
-    const auto patterns = match.query()->patterns();
-    const auto &pattern = patterns.at(match.patternIndex());
+    // The match keeps its query alive, so the pattern stays valid.
+    const auto &pattern = match.query()->predicateProgram().pattern(match.patternIndex());
 
-    for (const auto &predicate : pattern.predicates) {
-        const auto commands = Predicates::commands();
-        const auto it = commands.commandFunctions.find(predicate.name);
-        if (it != commands.commandFunctions.cend()) {
-            const auto commandPredicate = it->second;
-            (this->*(commandPredicate))(match, predicate.arguments);
-        }
+    for (const auto &predicate : pattern.commands) {
+        (this->*(predicate.command))(match, predicate);
     }
 }
 
 bool Predicates::filterMatch(const QueryMatch &match) const
 {
-    const auto patterns = match.query()->patterns();
-    const auto &pattern = patterns.at(match.patternIndex());
+    const auto &pattern = match.query()->predicateProgram().pattern(match.patternIndex());
 
-    for (const auto &predicate : pattern.predicates) {
-        const auto filters = Predicates::filters();
-        const auto it = filters.filterFunctions.find(predicate.name);
-        if (it != filters.filterFunctions.cend()) {
-            const auto filterPredicate = it->second;
-            if (!(this->*(filterPredicate))(match, predicate.arguments)) {
-                return false;
-            }
+    for (const auto &predicate : pattern.filters) {
+        if (!(this->*(predicate.filter))(match, predicate)) {
+            return false;
         }
     }
 
     return true;
 }
 
+PredicateProgram::PredicateProgram(const TSLanguage *language, const QList<Query::Pattern> &patterns)
+{
+    const auto &filters = Predicates::filters();
+    const auto &commands = Predicates::commands();
+
+    m_patterns.reserve(patterns.size());
+    for (const auto &pattern : patterns) {
+        Pattern compiledPattern;
+        for (const auto &predicate : pattern.predicates) {
+            CompiledPredicate compiled {.arguments = predicate.arguments};
+            for (const auto &argument : predicate.arguments) {
+                if (const auto *capture = std::get_if<Query::Capture>(&argument)) {
+                    compiled.captureIds.push_back(capture->id);
+                } else {
+                    compiled.strings.push_back(std::get<QString>(argument));
+                }
+            }
+
+            if (auto it = filters.filterFunctions.find(predicate.name); it != filters.filterFunctions.cend()) {
+                compiled.filter = it->second;
+                if (auto prepare = filters.prepareFunctions.find(predicate.name);
+                    prepare != filters.prepareFunctions.cend()) {
+                    prepare->second(compiled, language);
+                }
+                compiledPattern.filters.emplace_back(std::move(compiled));
+            } else if (auto it = commands.commandFunctions.find(predicate.name);
+                       it != commands.commandFunctions.cend()) {
+                compiled.command = it->second;
+                if (auto prepare = commands.prepareFunctions.find(predicate.name);
+                    prepare != commands.prepareFunctions.cend()) {
+                    prepare->second(compiled, language);
+                }
+                compiledPattern.commands.emplace_back(std::move(compiled));
+            }
+        }
+        m_patterns.emplace_back(std::move(compiledPattern));
+    }
+}
+
+const PredicateProgram::Pattern &PredicateProgram::pattern(uint32_t index) const
+{
+    return m_patterns.at(index);
+}
+
 std::optional<QString> Predicates::checkCommand_exclude(const Predicates::PredicateArguments &arguments)
 {
     if (arguments.size() < 2) {
@@ -145,30 +214,14 @@ std::optional<QString> Predicates::checkCommand_exclude(const Predicates::Predic
     return {};
 }
 
-void Predicates::command_exclude(QueryMatch &match, const Predicates::PredicateArguments &arguments) const
+void Predicates::command_exclude(QueryMatch &match, const CompiledPredicate &predicate) const
 {
-    auto to_string = [](const auto &variant) {
-        return std::get<QString>(variant);
-    };
-    auto is_string = [](const auto &variant) {
-        return std::holds_alternative<QString>(variant);
-    };
-    auto exclusions = kdalgorithms::filtered_transformed<std::set>(arguments, to_string, is_string);
-
-    auto to_capture_id = [](const auto &variant) {
-        return std::get<treesitter::Query::Capture>(variant).id;
-    };
-    auto is_capture = [](const auto &variant) {
-        return std::holds_alternative<treesitter::Query::Capture>(variant);
-    };
-    auto capture_ids = kdalgorithms::filtered_transformed<std::set>(arguments, to_capture_id, is_capture);
-
-    auto new_captures = kdalgorithms::filtered(match.captures(), [&exclusions, &capture_ids](const auto &capture) {
-        if (!capture_ids.contains(capture.id)) {
+    auto new_captures = kdalgorithms::filtered(match.captures(), [&predicate](const auto &capture) {
+        if (!predicate.captureIds.contains(capture.id)) {
             return true;
         }
 
-        return !exclusions.contains(capture.node.type());
+        return !predicate.nodeTypes.contains(capture.node.typeId());
     });
 
     match.setCaptures(std::move(new_captures));
@@ -181,34 +234,55 @@ std::optional<QString> Predicates::checkFilter_eq(const Predicates::PredicateArg
     }
     return {};
 }
-bool Predicates::filter_eq_with(const QueryMatch &match, const QList<std::variant<Query::Capture, QString>> &arguments,
-                                const std::function<QString(const QString &)> &textTransform) const
+bool Predicates::filter_eq_with(const QueryMatch &match, const CompiledPredicate &predicate,
+                                TextComparison textEquals) const
 {
-    std::set<QString> texts;
+    // All arguments must have the same text, so compare all of them to the first one.
+    std::optional<QStringView> first;
+    auto equalsFirst = [&first, textEquals](QStringView text) {
+        if (!first.has_value()) {
+            first = text;
+            return true;
+        }
+        return textEquals(*first, text);
+    };
+
+    const auto captures = match.captures();
+    for (const auto &argument : predicate.arguments) {
+        if (const auto *string = std::get_if<QString>(&argument)) {
+            if (!equalsFirst(*string)) {
+                return false;
+            }
+            continue;
+        }
 
-    const auto matched = matchArguments(match, arguments);
-    for (const auto &arg : matched) {
-        if (const auto *capture = std::get_if<QueryMatch::Capture>(&arg)) {
-            texts.emplace(textTransform(capture->node.textIn(m_source)));
-        } else if (const auto *string = std::get_if<QString>(&arg)) {
-            texts.emplace(textTransform(*string));
-        } else if (std::holds_alternative<MissingCapture>(arg)) {
+        const auto id = std::get<Query::Capture>(argument).id;
+        bool hasCapture = false;
+        // Multiple captures for the same ID may exist, if quantifiers are used.
+        for (const auto &capture : captures) {
+            if (capture.id == id) {
+                hasCapture = true;
+                if (!equalsFirst(capture.node.textView(m_source))) {
+                    return false;
+                }
+            }
+        }
+        if (!hasCapture) {
             spdlog::warn("Predicates: #eq? - Unmatched capture!");
-            // Insert an empty string into the set if we find an unmatched capture.
+            // Compare with an empty string if we find an unmatched capture.
             // This likely means we have encountered a quantified capture that matched 0 times.
-            // By inserting an empty string, we can check that all other things are also "empty".
-            texts.emplace("");
-        } else {
-            spdlog::warn("Predicates: #eq? - Impossible argument type!");
-            return false;
+            // By comparing to an empty string, we can check that all other things are also "empty".
+            if (!equalsFirst(QStringView())) {
+                return false;
+            }
         }
     }
-    return texts.size() == 1;
+    return true;
 }
 
-bool Predicates::filter_eq(const QueryMatch &match, const QList<std::variant<Query::Capture, QString>> &arguments) const
+bool Predicates::filter_eq(const QueryMatch &match, const CompiledPredicate &predicate) const
 {
-    return filter_eq_with(match, arguments, QString_identity);
+    return filter_eq_with(match, predicate, textEquals);
 }
 
 std::optional<QString> Predicates::checkFilter_eq_except(const Predicates::PredicateArguments &arguments)
@@ -237,89 +311,64 @@ std::optional<QString> Predicates::checkFilter_eq_except(const Predicates::Predi
     return {};
 }
 
-bool Predicates::filter_like(const QueryMatch &match,
-                             const QList<std::variant<Query::Capture, QString>> &arguments) const
+bool Predicates::filter_like(const QueryMatch &match, const CompiledPredicate &predicate) const
 {
-    return filter_eq_with(match, arguments, QString_no_whitespace);
+    return filter_eq_with(match, predicate, textEqualsIgnoringWhitespace);
 }
-bool Predicates::filter_eq_except_with(const QueryMatch &match,
-                                       const QList<std::variant<Query::Capture, QString>> &arguments,
-                                       const std::function<QString(const QString &)> &textTransform) const
+void Predicates::prepareFilter_eq_except(CompiledPredicate &predicate, const TSLanguage *language)
 {
-    auto args = arguments;
-    if (const auto *rawExpected = std::get_if<QString>(&args.front())) {
-        auto expected = textTransform(*rawExpected);
-        args.pop_front();
-        if (const auto *rawCapture = std::get_if<Query::Capture>(&args.front())) {
-            // we need to copy the capture here, as otherwise it might get dropped
-            // when we pop_front() on args
-            auto capture = *rawCapture;
-            args.pop_front();
-
-            auto types = QList<QString>();
-            for (const auto &arg : std::as_const(args)) {
-                if (const auto *type = std::get_if<QString>(&arg)) {
-                    types.push_back(*type);
-                }
-            }
+    // The first string is the expected text, all other strings are node types (see checkFilter_eq_except).
+    predicate.nodeTypes = Node::typeIdsForNames(language, predicate.strings.sliced(1));
+}
 
-            const auto idCaptures = match.capturesWithId(capture.id);
-            if (idCaptures.isEmpty()) {
-                spdlog::warn("Predicates: #eq_except? - No captures");
-                // Insert an empty string into the set if we find an unmatched capture.
-                // This likely means we have encountered a quantified capture that matched 0 times.
-                // So check whether the expected string is also empty
-                return expected.isEmpty();
-            }
+void Predicates::prepareNodeTypes(CompiledPredicate &predicate, const TSLanguage *language)
+{
+    predicate.nodeTypes = Node::typeIdsForNames(language, predicate.strings);
+}
 
-            for (const auto &idCapture : idCaptures) {
-                if (expected != textTransform(idCapture.node.textExcept(m_source, types))) {
-                    return false;
-                }
+bool Predicates::filter_eq_except_with(const QueryMatch &match, const CompiledPredicate &predicate,
+                                       TextComparison textEquals) const
+{
+    const auto &expected = predicate.strings.first();
+    const auto id = predicate.captureIds.first();
+
+    bool hasCapture = false;
+    const auto captures = match.captures();
+    for (const auto &capture : captures) {
+        if (capture.id == id) {
+            hasCapture = true;
+            if (!textEquals(expected, capture.node.textExcept(m_source, predicate.nodeTypes))) {
+                return false;
             }
-
-            return true;
-        } else {
-            spdlog::warn("Predicates: #eq_except? - Expected Capture argument");
-            return false;
         }
-    } else {
-        spdlog::warn("Predicates: #eq_except? - Non-string expected argument");
-        return false;
     }
+
+    if (!hasCapture) {
+        spdlog::warn("Predicates: #eq_except? - No captures");
+        // This likely means we have encountered a quantified capture that matched 0 times.
+        // So check whether the expected string is also empty
+        return textEquals(expected, QStringView());
+    }
+    return true;
 }
 
-bool Predicates::filter_eq_except(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_eq_except(const QueryMatch &match, const CompiledPredicate &predicate) const
 {
-    return filter_eq_except_with(match, arguments, QString_identity);
+    return filter_eq_except_with(match, predicate, textEquals);
 }
 
-bool Predicates::filter_like_except(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_like_except(const QueryMatch &match, const CompiledPredicate &predicate) const
 {
-    return filter_eq_except_with(match, arguments, QString_no_whitespace);
+    return filter_eq_except_with(match, predicate, textEqualsIgnoringWhitespace);
 }
 
-bool Predicates::filter_not_is(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_not_is(const QueryMatch &match, const CompiledPredicate &predicate) const
 {
-    const auto matched = matchArguments(match, arguments);
-
-    auto captures = QList<QueryMatch::Capture>();
-    auto types = QList<QString>();
-
-    for (const auto &arg : matched) {
-        if (auto capture = std::get_if<QueryMatch::Capture>(&arg)) {
-            captures.push_back(*capture);
-        }
-        if (auto type_name = std::get_if<QString>(&arg)) {
-            types.push_back(*type_name);
-        }
-        // Unmatched captures are ignored, they are definitely not of the forbidden type.
-    }
-
-    auto containsType = [&types](const auto &capture) {
-        return types.contains(capture.node.type());
+    // Unmatched captures are ignored, they are definitely not of the forbidden type.
+    auto isForbidden = [&predicate](const auto &capture) {
+        return predicate.captureIds.contains(capture.id) && predicate.nodeTypes.contains(capture.node.typeId());
     };
-    return std::ranges::none_of(captures, containsType);
+    return std::ranges::none_of(match.captures(), isForbidden);
 }
 
 std::optional<QString> Predicates::checkFilter_like(const Predicates::PredicateArguments &arguments)
@@ -380,40 +429,30 @@ std::optional<QString> Predicates::checkFilter_not_is(const Predicates::Predicat
     return std::nullopt;
 }
 
-bool Predicates::filter_match(const QueryMatch &match,
-                              const QList<std::variant<Query::Capture, QString>> &arguments) const
+void Predicates::prepareFilter_match(CompiledPredicate &predicate, const TSLanguage * /*language*/)
 {
-    const auto matched = matchArguments(match, arguments);
-
-    if (arguments.size() < 2) {
-        return false;
-    }
-
-    if (const auto regexString = std::get_if<QString>(&matched.first())) {
-        const QRegularExpression regex(*regexString);
-        if (!regex.isValid()) {
-            spdlog::warn("Predicates: #match? - Invalid regex");
-            return false;
-        }
+    // The regex is the first argument (see checkFilter_match), compile it once for all matches.
+    predicate.regex = QRegularExpression(predicate.strings.first());
+    predicate.regex.optimize();
+}
 
-        for (const auto &argument : matched | std::views::drop(1)) {
-            if (const auto *capture = std::get_if<QueryMatch::Capture>(&argument)) {
-                auto source = capture->node.textIn(m_source);
-                if (!regex.match(source).hasMatch()) {
+bool Predicates::filter_match(const QueryMatch &match, const CompiledPredicate &predicate) const
+{
+    const auto captures = match.captures();
+    for (const auto id : predicate.captureIds) {
+        bool hasCapture = false;
+        for (const auto &capture : captures) {
+            if (capture.id == id) {
+                hasCapture = true;
+                if (!regexMatches(predicate.regex, capture.node.textView(m_source))) {
                     return false;
                 }
-            } else if (std::holds_alternative<MissingCapture>(argument)) {
-                spdlog::warn("Predicates: #match? - Unmatched capture argument");
-                return false;
-            } else {
-                spdlog::warn("Predicates: #match? - Argument is not a capture");
-                return false;
             }
         }
-    } else {
-
-        spdlog::warn("Predicates: #match? - First argument is not a string");
-        return false;
+        if (!hasCapture) {
+            spdlog::warn("Predicates: #match? - Unmatched capture argument");
+            return false;
+        }
     }
 
     return true;
@@ -451,12 +490,12 @@ void Predicates::findMessageMap() const
         return;
     }
 
-    // This variable is "static" because Query construction is actually a non-trivial task.
+    // The query comes from the QueryCache because Query construction is actually a non-trivial task.
     // We don't want to construct the query every time we call this function, as it's always the same query anyway.
     //
     // This has caused performance problems in the past, when combined with the ScriptSuggestions model, which queries
     // after every keystroke.
-    static auto query = std::make_shared<Query>(tree_sitter_cpp() /*in_message_map only makes sense in C++*/, R"EOF(
+    auto query = QueryCache::instance().get(tree_sitter_cpp() /*in_message_map only makes sense in C++*/, R"EOF(
 (
 (expression_statement
     (call_expression
@@ -499,12 +538,12 @@ std::optional<QString> Predicates::checkFilter_in_message_map(const Predicates::
     return {};
 }
 
-bool Predicates::filter_in_message_map(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_in_message_map(const QueryMatch &match, const CompiledPredicate &predicate) const
 {
     findMessageMap();
 
     if (const auto *message_map = findCache<MessageMapCache>()) {
-        const auto matched = matchArguments(match, arguments);
+        const auto matched = matchArguments(match, predicate.arguments);
 
         for (const auto &argument : matched) {
             if (const auto capture = std::get_if<QueryMatch::Capture>(&argument)) {
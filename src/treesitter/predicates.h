@@ -13,7 +13,9 @@
 #include "node.h"
 #include "query.h"
 
+#include <QRegularExpression>
 #include <QString>
+#include <QStringList>
 
 namespace treesitter {
 
@@ -26,6 +28,45 @@ public:
     virtual ~PredicateCache() = default;
 };
 
+// A predicate of a pattern, resolved to the member function of Predicates implementing it.
+// The arguments are split by kind once, so executing the predicate doesn't need to do it for every match.
+struct CompiledPredicate
+{
+    using Arguments = QVector<std::variant<Query::Capture, QString>>;
+
+    bool (Predicates::*filter)(const QueryMatch &, const CompiledPredicate &) const = nullptr;
+    void (Predicates::*command)(QueryMatch &, const CompiledPredicate &) const = nullptr;
+
+    Arguments arguments;
+    // The capture and string arguments, in the order they appear in.
+    QVector<uint32_t> captureIds;
+    QStringList strings;
+
+    // Prepared for specific predicates, see Predicates::prepareFilter_*
+    QRegularExpression regex;
+    QVector<Node::TypeId> nodeTypes;
+};
+
+// The predicates of all patterns of a query, built once when the query is constructed.
+// Running a match through it doesn't do any lookup by name, nor any allocation.
+class PredicateProgram
+{
+public:
+    struct Pattern
+    {
+        QVector<CompiledPredicate> commands;
+        QVector<CompiledPredicate> filters;
+    };
+
+    // The predicates must have been checked with Predicates::checkPredicate before.
+    PredicateProgram(const TSLanguage *language, const QVector<Query::Pattern> &patterns);
+
+    const Pattern &pattern(uint32_t index) const;
+
+private:
+    QVector<Pattern> m_patterns;
+};
+
 // At the moment, predicates are just member functions of the Predicates class.
 // However, in the future we may want to separate the Predicates class into two:
 // 1. A PredicateList class, containing a list of predicates, but no context for the predicates to execute
@@ -38,21 +79,27 @@ class Predicates
     using PredicateArguments = QVector<std::variant<Query::Capture, QString>>;
     struct Filters
     {
-        std::unordered_map<QString, bool (Predicates::*)(const QueryMatch &, const PredicateArguments &) const>
+        std::unordered_map<QString, bool (Predicates::*)(const QueryMatch &, const CompiledPredicate &) const>
             filterFunctions;
 
         std::unordered_map<QString, std::optional<QString> (*)(const PredicateArguments &)> checkFunctions;
+
+        // Optional, prepares the data needed by the filter once, when the query is constructed.
+        std::unordered_map<QString, void (*)(CompiledPredicate &, const TSLanguage *)> prepareFunctions;
     };
 
     struct Commands
     {
         std::unordered_map<QString, std::optional<QString> (*)(const PredicateArguments &)> checkFunctions;
-        std::unordered_map<QString, void (Predicates::*)(QueryMatch &, const PredicateArguments &) const>
+        std::unordered_map<QString, void (Predicates::*)(QueryMatch &, const CompiledPredicate &) const>
             commandFunctions;
+
+        // Optional, same as Filters::prepareFunctions.
+        std::unordered_map<QString, void (*)(CompiledPredicate &, const TSLanguage *)> prepareFunctions;
     };
 
-    static Filters filters();
-    static Commands commands();
+    static const Filters &filters();
+    static const Commands &commands();
 
 public:
     explicit Predicates(QString source);
@@ -69,7 +116,7 @@ public:
 private:
     // ################# Commands #########################
 #define PREDICATE_COMMAND(NAME)                                                                                        \
-    void command_##NAME(QueryMatch &match, const PredicateArguments &arguments) const;                                 \
+    void command_##NAME(QueryMatch &match, const CompiledPredicate &predicate) const;                                  \
     static std::optional<QString> checkCommand_##NAME(const PredicateArguments &arguments);
 
     PREDICATE_COMMAND(exclude)
@@ -77,7 +124,7 @@ private:
 
     // ################## Filters #########################
 #define PREDICATE_FILTER(NAME)                                                                                         \
-    bool filter_##NAME(const QueryMatch &match, const PredicateArguments &arguments) const;                            \
+    bool filter_##NAME(const QueryMatch &match, const CompiledPredicate &predicate) const;                             \
     static std::optional<QString> checkFilter_##NAME(const PredicateArguments &arguments)
 
     PREDICATE_FILTER(eq);
@@ -89,10 +136,15 @@ private:
     PREDICATE_FILTER(not_is);
 #undef PREDICATE_FILTER
 
-    bool filter_eq_with(const QueryMatch &match, const QVector<std::variant<Query::Capture, QString>> &arguments,
-                        const std::function<QString(const QString &)> &textTransform) const;
-    bool filter_eq_except_with(const QueryMatch &match, const QVector<std::variant<Query::Capture, QString>> &arguments,
-                               const std::function<QString(const QString &)> &textTransform) const;
+    static void prepareFilter_match(CompiledPredicate &predicate, const TSLanguage *language);
+    static void prepareFilter_eq_except(CompiledPredicate &predicate, const TSLanguage *language);
+    // The string arguments are node types, look up their ids.
+    static void prepareNodeTypes(CompiledPredicate &predicate, const TSLanguage *language);
+
+    using TextComparison = bool (*)(QStringView, QStringView);
+    bool filter_eq_with(const QueryMatch &match, const CompiledPredicate &predicate, TextComparison textEquals) const;
+    bool filter_eq_except_with(const QueryMatch &match, const CompiledPredicate &predicate,
+                               TextComparison textEquals) const;
 
     // ################## Argument matching #########################
     // Marker type indicating a capture is missing
@@ -124,6 +176,7 @@ private:
 
     // ################## Context data #########################
     friend class QueryCursor;
+    friend class PredicateProgram;
     void setRootNode(const Node &node);
 
     const QString m_source;
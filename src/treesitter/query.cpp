@@ -19,9 +19,24 @@
 namespace treesitter {
 
 Query::Query(const TSLanguage *language, const QString &query)
-    : m_query(nullptr)
+    : Query(language, QStringList {query})
 {
-    m_utf8_text = query.toUtf8();
+}
+
+Query::Query(const TSLanguage *language, const QStringList &queries)
+    : m_subQueryCount(static_cast<int>(queries.size()))
+    , m_query(nullptr)
+{
+    // Start offset of each sub-query in the combined text, to find which one a pattern comes from.
+    QVector<uint32_t> subQueryStarts;
+    subQueryStarts.reserve(queries.size());
+    for (const auto &query : queries) {
+        if (!m_utf8_text.isEmpty())
+            m_utf8_text.append('\n');
+        subQueryStarts.push_back(static_cast<uint32_t>(m_utf8_text.size()));
+        m_utf8_text.append(query.toUtf8());
+    }
+
     uint32_t error_offset;
     TSQueryError error_type;
     m_query = ts_query_new(language, m_utf8_text.data(), m_utf8_text.size(), &error_offset, &error_type);
@@ -36,8 +51,22 @@ Query::Query(const TSLanguage *language, const QString &query)
         };
     }
 
-    const auto patterns = this->patterns();
-    for (const auto &pattern : patterns) {
+    auto count = ts_query_pattern_count(m_query);
+    m_patterns.reserve(count);
+    int subQuery = 0;
+    for (uint32_t patternIndex = 0; patternIndex < count; ++patternIndex) {
+        auto start_byte = ts_query_start_byte_for_pattern(m_query, patternIndex);
+        auto predicates = predicatesForPattern(patternIndex);
+
+        // Patterns are ordered by their position in the text, so the sub-query only ever increases.
+        while (subQuery + 1 < subQueryStarts.size() && subQueryStarts[subQuery + 1] <= start_byte)
+            ++subQuery;
+
+        m_patterns.emplace_back(
+            Pattern {.predicates = std::move(predicates), .utf8_start_byte = start_byte, .subQuery = subQuery});
+    }
+
+    for (const auto &pattern : std::as_const(m_patterns)) {
         for (const auto &predicate : pattern.predicates) {
             auto error = Predicates::checkPredicate(predicate);
             if (error.has_value()) {
@@ -45,14 +74,23 @@ Query::Query(const TSLanguage *language, const QString &query)
                 auto offset = m_utf8_text.indexOf(predicateString);
                 offset = offset >= 0 ? offset : 0;
 
+                // The destructor won't run, as the constructor doesn't finish.
+                ts_query_delete(m_query);
+                m_query = nullptr;
                 throw Error {.utf8_offset = static_cast<uint32_t>(offset), .description = error.value()};
             }
         }
     }
+
+    m_predicateProgram = std::make_unique<PredicateProgram>(language, m_patterns);
 }
 
 Query::Query(Query &&other) noexcept
-    : m_query(other.m_query)
+    : m_utf8_text(std::move(other.m_utf8_text))
+    , m_patterns(std::move(other.m_patterns))
+    , m_subQueryCount(other.m_subQueryCount)
+    , m_predicateProgram(std::move(other.m_predicateProgram))
+    , m_query(other.m_query)
 {
     other.m_query = nullptr;
 }
@@ -72,6 +110,10 @@ Query &Query::operator=(Query &&other) noexcept
 
 void Query::swap(Query &other) noexcept
 {
+    std::swap(m_utf8_text, other.m_utf8_text);
+    std::swap(m_patterns, other.m_patterns);
+    std::swap(m_subQueryCount, other.m_subQueryCount);
+    std::swap(m_predicateProgram, other.m_predicateProgram);
     std::swap(m_query, other.m_query);
 }
 
@@ -110,19 +152,19 @@ QList<Query::Predicate> Query::predicatesForPattern(uint32_t index) const
     return predicates;
 }
 
-QList<Query::Pattern> Query::patterns() const
+const QList<Query::Pattern> &Query::patterns() const
 {
-    QList<Query::Pattern> result;
+    return m_patterns;
+}
 
-    auto count = ts_query_pattern_count(m_query);
-    result.reserve(count);
-    for (uint32_t patternIndex = 0; patternIndex < count; ++patternIndex) {
-        auto start_byte = ts_query_start_byte_for_pattern(m_query, patternIndex);
-        auto predicates = predicatesForPattern(patternIndex);
+int Query::subQueryCount() const
+{
+    return m_subQueryCount;
+}
 
-        result.emplace_back(Pattern {.predicates = std::move(predicates), .utf8_start_byte = start_byte});
-    }
-    return result;
+const PredicateProgram &Query::predicateProgram() const
+{
+    return *m_predicateProgram;
 }
 
 QList<Query::Capture> Query::captures() const
@@ -252,6 +294,22 @@ void QueryCursor::setProgressCallback(std::function<void()> callback)
     m_progressCallback = std::move(callback);
 }
 
+void QueryCursor::setMatchLimit(uint32_t limit)
+{
+    ts_query_cursor_set_match_limit(m_cursor, limit == 0 ? UINT32_MAX : limit);
+}
+
+uint32_t QueryCursor::matchLimit() const
+{
+    const auto limit = ts_query_cursor_match_limit(m_cursor);
+    return limit == UINT32_MAX ? 0 : limit;
+}
+
+bool QueryCursor::didExceedMatchLimit() const
+{
+    return ts_query_cursor_did_exceed_match_limit(m_cursor);
+}
+
 std::optional<QueryMatch> QueryCursor::nextMatch()
 {
     TSQueryMatch match;
@@ -283,4 +341,17 @@ QList<QueryMatch> QueryCursor::allRemainingMatches()
     return matches;
 }
 
+void QueryCursor::dispatchRemainingMatches(const QList<MatchSink> &sinks)
+{
+    Q_ASSERT(sinks.size() == m_query->subQueryCount());
+
+    const auto &patterns = m_query->patterns();
+    for (auto match = nextMatch(); match.has_value(); match = nextMatch()) {
+        const auto &sink = sinks[patterns[match->patternIndex()].subQuery];
+        if (sink) {
+            sink(match.value());
+        }
+    }
+}
+
 }
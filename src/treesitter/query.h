@@ -14,8 +14,10 @@
 
 #include <QByteArray>
 #include <QString>
+#include <QStringList>
 #include <QVector>
 #include <functional>
+#include <memory>
 #include <tree_sitter/api.h>
 
 struct TSLanguage;
@@ -26,6 +28,7 @@ namespace treesitter {
 
 class Node;
 class Predicates;
+class PredicateProgram;
 
 class Query
 {
@@ -46,6 +49,8 @@ public:
     {
         QVector<Predicate> predicates;
         uint32_t utf8_start_byte;
+        // Index of the query this pattern comes from, when several queries are combined.
+        int subQuery = 0;
     };
 
     struct Error
@@ -56,6 +61,10 @@ public:
 
     // throws a Query::Error if the query is ill-formed.
     Query(const TSLanguage *language, const QString &query);
+    // Combines several queries into a single one, so they can all be run in one traversal of the tree.
+    // Each pattern remembers which of the queries it comes from, see Pattern::subQuery.
+    // throws a Query::Error if any of the queries is ill-formed, the offset is relative to the combined text.
+    Query(const TSLanguage *language, const QStringList &queries);
 
     Query(const Query &) = delete;
     Query(Query &&) noexcept;
@@ -67,7 +76,11 @@ public:
 
     void swap(Query &other) noexcept;
 
-    QVector<Pattern> patterns() const;
+    const QVector<Pattern> &patterns() const;
+    int subQueryCount() const;
+
+    // The predicates of all patterns, resolved when the query is constructed.
+    const PredicateProgram &predicateProgram() const;
 
     QVector<Capture> captures() const;
     Capture captureAt(uint32_t index) const;
@@ -76,6 +89,9 @@ private:
     QVector<Predicate> predicatesForPattern(uint32_t index) const;
 
     QByteArray m_utf8_text;
+    QVector<Pattern> m_patterns;
+    int m_subQueryCount = 1;
+    std::unique_ptr<PredicateProgram> m_predicateProgram;
     TSQuery *m_query;
 
     friend class QueryCursor;
@@ -146,10 +162,23 @@ public:
     // will no longer return new matches.
     QVector<QueryMatch> allRemainingMatches();
 
+    using MatchSink = std::function<void(const QueryMatch &)>;
+    // Get all remaining matches of a combined query, passing each match to the sink of the
+    // query its pattern comes from. There must be one sink per sub-query.
+    // Like allRemainingMatches, this consumes the cursor.
+    void dispatchRemainingMatches(const QVector<MatchSink> &sinks);
+
     // The progress callback is called after each match is found, even if it is discarded later by the predicate engine.
     // It allows the UI to update and remain responsive while the query is running.
     void setProgressCallback(std::function<void()> callback);
 
+    // Limits the number of in-progress matches tree-sitter keeps while running the query, which bounds its memory.
+    // When the limit is exceeded, the oldest in-progress matches are dropped, so some matches may be missing.
+    // Must be called before execute, 0 means no limit.
+    void setMatchLimit(uint32_t limit);
+    uint32_t matchLimit() const;
+    bool didExceedMatchLimit() const;
+
 private:
     // The query must be kept alive for as long as the cursor is alive.
     // Otherwise, no new matches can be returned and the Predicates can't be executed.
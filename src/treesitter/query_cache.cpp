@@ -0,0 +1,112 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "query_cache.h"
+
+#include <QHash>
+
+namespace treesitter {
+
+QueryCache::QueryCache(size_t capacity)
+    : m_capacity(capacity)
+{
+}
+
+QueryCache &QueryCache::instance()
+{
+    static QueryCache cache;
+    return cache;
+}
+
+size_t QueryCache::KeyHash::operator()(const Key &key) const
+{
+    return qHash(key.queries, reinterpret_cast<size_t>(key.language));
+}
+
+std::shared_ptr<Query> QueryCache::get(const TSLanguage *language, const QString &query)
+{
+    return get(language, QStringList {query});
+}
+
+std::shared_ptr<Query> QueryCache::get(const TSLanguage *language, const QStringList &queries)
+{
+    Key key {.language = language, .queries = queries};
+    {
+        std::lock_guard lock(m_mutex);
+        if (auto it = m_index.find(key); it != m_index.end()) {
+            ++m_statistics.hits;
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return it->second->second;
+        }
+        ++m_statistics.misses;
+    }
+
+    // Compile outside of the lock, so other threads are not blocked by a slow compilation.
+    auto compiled = std::make_shared<Query>(language, queries);
+
+    std::lock_guard lock(m_mutex);
+    // Another thread may have compiled the same query in the meantime, share the existing one.
+    if (auto it = m_index.find(key); it != m_index.end()) {
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return it->second->second;
+    }
+    m_entries.emplace_front(key, compiled);
+    m_index.emplace(std::move(key), m_entries.begin());
+    evict();
+    return compiled;
+}
+
+void QueryCache::evict()
+{
+    while (m_entries.size() > m_capacity) {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+}
+
+QueryCache::Statistics QueryCache::statistics() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_statistics;
+}
+
+void QueryCache::resetStatistics()
+{
+    std::lock_guard lock(m_mutex);
+    m_statistics = {};
+}
+
+size_t QueryCache::size() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_entries.size();
+}
+
+size_t QueryCache::capacity() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_capacity;
+}
+
+void QueryCache::setCapacity(size_t capacity)
+{
+    std::lock_guard lock(m_mutex);
+    m_capacity = capacity;
+    evict();
+}
+
+void QueryCache::clear()
+{
+    std::lock_guard lock(m_mutex);
+    m_entries.clear();
+    m_index.clear();
+}
+
+}
@@ -0,0 +1,96 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "query.h"
+
+#include <QString>
+#include <QStringList>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+struct TSLanguage;
+
+namespace treesitter {
+
+/**
+ * Cache of compiled queries, keyed by language and query text.
+ *
+ * Compiling a query (and checking its predicates) is not cheap, but scripts tend to run the same
+ * queries over and over again, on many documents. The cache keeps the most recently used queries
+ * around, and evicts the least recently used ones once its capacity is reached.
+ *
+ * The cache is thread-safe, and the returned queries may be shared between multiple QueryCursors.
+ */
+class QueryCache
+{
+public:
+    struct Statistics
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    static constexpr size_t DefaultCapacity = 256;
+
+    explicit QueryCache(size_t capacity = DefaultCapacity);
+
+    QueryCache(const QueryCache &) = delete;
+    QueryCache &operator=(const QueryCache &) = delete;
+
+    // Shared cache used by the documents.
+    static QueryCache &instance();
+
+    // Returns the compiled query, compiling it if it is not in the cache yet.
+    // throws a Query::Error if the query is ill-formed, failed queries are not cached.
+    std::shared_ptr<Query> get(const TSLanguage *language, const QString &query);
+    // Same for a query combining several queries, see Query::Query(const TSLanguage *, const QStringList &).
+    std::shared_ptr<Query> get(const TSLanguage *language, const QStringList &queries);
+
+    Statistics statistics() const;
+    void resetStatistics();
+
+    size_t size() const;
+    size_t capacity() const;
+    void setCapacity(size_t capacity);
+
+    void clear();
+
+private:
+    struct Key
+    {
+        const TSLanguage *language;
+        // A single entry, unless several queries are combined.
+        QStringList queries;
+
+        bool operator==(const Key &other) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const;
+    };
+
+    using Entry = std::pair<Key, std::shared_ptr<Query>>;
+
+    void evict();
+
+    mutable std::mutex m_mutex;
+    // Most recently used entries first.
+    std::list<Entry> m_entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_index;
+    size_t m_capacity;
+    Statistics m_statistics;
+};
+
+}
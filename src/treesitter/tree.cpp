@@ -49,4 +49,9 @@ Node Tree::rootNode() const
     return Node(ts_tree_root_node(m_tree));
 }
 
+void Tree::edit(const TSInputEdit &edit)
+{
+    ts_tree_edit(m_tree, &edit);
+}
+
 }
@@ -31,6 +31,14 @@ public:
 
     Node rootNode() const;
 
+    /**
+     * Adjust the tree to match a change in the source text, so it can be passed to
+     * Parser::parseString to parse the new text incrementally.
+     *
+     * Note: This invalidates all existing Node instances of this tree!
+     */
+    void edit(const TSInputEdit &edit);
+
     void swap(Tree &other) noexcept;
 
 private:
@@ -39,9 +47,6 @@ private:
     TSTree *m_tree;
 
     friend class Parser;
-
-    // TODO: Once update is implemented, store weak pointers to all
-    // TSNodes so that they may be updated as well.
 };
 
 }
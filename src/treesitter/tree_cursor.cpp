@@ -10,6 +10,11 @@ TreeCursor::TreeCursor(Node node)
     m_cursor = ts_tree_cursor_new(node.m_node);
 }
 
+TreeCursor::~TreeCursor()
+{
+    ts_tree_cursor_delete(&m_cursor);
+}
+
 Node TreeCursor::currentNode() const
 {
     return ts_tree_cursor_current_node(&m_cursor);
@@ -26,6 +31,11 @@ bool TreeCursor::gotoFirstChild()
     return ts_tree_cursor_goto_first_child(&m_cursor);
 }
 
+bool TreeCursor::gotoFirstChildForByte(uint32_t byte)
+{
+    return ts_tree_cursor_goto_first_child_for_byte(&m_cursor, byte) >= 0;
+}
+
 bool TreeCursor::gotoNextSibling()
 {
     return ts_tree_cursor_goto_next_sibling(&m_cursor);
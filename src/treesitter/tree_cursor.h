@@ -20,12 +20,15 @@ public:
     TreeCursor(Node);
     TreeCursor(const TreeCursor &) = delete;
     TreeCursor(TreeCursor &&) = delete;
+    ~TreeCursor();
 
     Node currentNode() const;
     /// This returns a null QString if there is no field name
     QString currentFieldName() const;
 
     bool gotoFirstChild();
+    // Moves to the first child that extends beyond the given byte offset.
+    bool gotoFirstChildForByte(uint32_t byte);
     bool gotoNextSibling();
     bool gotoParent();
 
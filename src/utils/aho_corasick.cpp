@@ -0,0 +1,139 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "aho_corasick.h"
+#include "string_helper.h"
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+
+namespace Utils {
+
+static quint64 edgeKey(int node, char16_t character)
+{
+    return (static_cast<quint64>(node) << 16) | character;
+}
+
+AhoCorasick::AhoCorasick(const QStringList &patterns, Qt::CaseSensitivity caseSensitivity, bool wholeWords)
+    : m_patterns(patterns)
+    , m_caseSensitivity(caseSensitivity)
+    , m_wholeWords(wholeWords)
+{
+    // Build the trie, the root is the node 0
+    m_nodes.emplace_back();
+    for (int index = 0; index < m_patterns.size(); ++index) {
+        int node = 0;
+        for (const auto character : m_patterns.at(index)) {
+            const auto c = normalized(character);
+            int next = child(node, c);
+            if (next == -1) {
+                next = static_cast<int>(m_nodes.size());
+                m_nodes.push_back({.parent = node, .character = c, .depth = m_nodes[node].depth + 1});
+                m_edges.emplace(edgeKey(node, c), next);
+            }
+            node = next;
+        }
+        // The first pattern wins if there are duplicates
+        if (node != 0 && m_nodes[node].pattern == -1)
+            m_nodes[node].pattern = index;
+    }
+
+    // Compute the failure links breadth-first, so the links of the parents are known
+    std::vector<int> order(m_nodes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, {}, [this](int node) {
+        return m_nodes[node].depth;
+    });
+    for (const auto node : order) {
+        auto &current = m_nodes[node];
+        if (current.depth > 1) {
+            int fail = m_nodes[current.parent].fail;
+            while (fail != 0 && child(fail, current.character) == -1)
+                fail = m_nodes[fail].fail;
+            current.fail = std::max(child(fail, current.character), 0);
+        }
+        current.output = current.pattern != -1 ? node : (node == 0 ? -1 : m_nodes[current.fail].output);
+    }
+}
+
+const QStringList &AhoCorasick::patterns() const
+{
+    return m_patterns;
+}
+
+std::vector<AhoCorasick::Match> AhoCorasick::findAll(QStringView text) const
+{
+    std::vector<Match> matches;
+    std::optional<Match> candidate;
+    int state = 0;
+    qsizetype position = 0;
+
+    // Restart the search after the candidate, as the matches can't overlap
+    auto acceptCandidate = [&]() {
+        matches.push_back(*candidate);
+        position = candidate->start + candidate->length;
+        candidate.reset();
+        state = 0;
+    };
+
+    while (position < text.size() || candidate) {
+        if (position == text.size()) {
+            acceptCandidate();
+            continue;
+        }
+
+        state = transition(state, normalized(text.at(position)));
+        const auto end = position + 1;
+
+        // The outputs are visited from the longest to the shortest, the first one accepted starts first
+        for (int node = m_nodes[state].output; node != -1; node = m_nodes[m_nodes[node].fail].output) {
+            const auto start = end - m_nodes[node].depth;
+            if (m_wholeWords && !Utils::isWholeWord(text, start, end))
+                continue;
+            if (!candidate || start < candidate->start
+                || (start == candidate->start && end - start > candidate->length))
+                candidate = Match {start, end - start, m_nodes[node].pattern};
+            break;
+        }
+
+        // Any match found later starts after end - depth, the candidate can't be replaced by a better one
+        if (candidate && candidate->start < end - m_nodes[state].depth)
+            acceptCandidate();
+        else
+            position = end;
+    }
+    return matches;
+}
+
+char16_t AhoCorasick::normalized(QChar character) const
+{
+    return m_caseSensitivity == Qt::CaseSensitive ? character.unicode() : character.toCaseFolded().unicode();
+}
+
+int AhoCorasick::child(int node, char16_t character) const
+{
+    const auto it = m_edges.find(edgeKey(node, character));
+    return it == m_edges.end() ? -1 : it->second;
+}
+
+int AhoCorasick::transition(int node, char16_t character) const
+{
+    while (true) {
+        const int next = child(node, character);
+        if (next != -1)
+            return next;
+        if (node == 0)
+            return 0;
+        node = m_nodes[node].fail;
+    }
+}
+
+} // namespace Utils
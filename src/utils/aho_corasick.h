@@ -0,0 +1,78 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QStringList>
+#include <QStringView>
+
+#include <unordered_map>
+#include <vector>
+
+namespace Utils {
+
+/**
+ * @brief Finds many literal strings in a text in one pass
+ *
+ * The automaton is built once from the list of patterns, and can then be used to search any number of texts, each
+ * search being linear in the size of the text, whatever the number of patterns.
+ */
+class AhoCorasick
+{
+public:
+    struct Match
+    {
+        qsizetype start = 0;
+        qsizetype length = 0;
+        // Index of the pattern in the list of patterns
+        int pattern = -1;
+    };
+
+    /**
+     * Creates the automaton for `patterns`, empty patterns are ignored.
+     * If `wholeWords` is true, a match can't start or end in the middle of a word.
+     */
+    explicit AhoCorasick(const QStringList &patterns, Qt::CaseSensitivity caseSensitivity = Qt::CaseSensitive,
+                         bool wholeWords = false);
+
+    const QStringList &patterns() const;
+
+    /**
+     * Returns all the matches in `text`, in the order of the text.
+     * The matches don't overlap: the leftmost match is used, and the longest pattern for a given start.
+     */
+    std::vector<Match> findAll(QStringView text) const;
+
+private:
+    struct Node
+    {
+        int parent = 0;
+        char16_t character = 0;
+        int depth = 0;
+        int fail = 0;
+        // Pattern ending on this node, or -1
+        int pattern = -1;
+        // Closest node ending a pattern, following the failure links from this node (included), or -1
+        int output = -1;
+    };
+
+    char16_t normalized(QChar character) const;
+    int child(int node, char16_t character) const;
+    int transition(int node, char16_t character) const;
+
+    QStringList m_patterns;
+    Qt::CaseSensitivity m_caseSensitivity;
+    bool m_wholeWords;
+    std::vector<Node> m_nodes;
+    // Edges of the trie, the key is the node index and the character
+    std::unordered_map<quint64, int> m_edges;
+};
+
+} // namespace Utils
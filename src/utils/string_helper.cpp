@@ -226,4 +226,19 @@ QRegularExpression createRegularExpression(const QString &txt, int flags, bool i
     return QRegularExpression(isRegExp ? txt : QRegularExpression::escape(txt), options);
 }
 
+bool isWholeWord(QStringView text, qsizetype start, qsizetype end)
+{
+    auto isWordCharacter = [text](qsizetype index) {
+        if (index < 0 || index >= text.size())
+            return false;
+        const QChar character = text.at(index);
+        return character.isLetterOrNumber() || character == u'_';
+    };
+    // Same as `\b`: there's a word boundary if only one of the characters around the position is a word character.
+    auto isWordBoundary = [&isWordCharacter](qsizetype position) {
+        return isWordCharacter(position - 1) != isWordCharacter(position);
+    };
+    return isWordBoundary(start) && isWordBoundary(end);
+}
+
 } // namespace Migration
@@ -34,4 +34,10 @@ QString expandRegExpReplacement(const QString &replaceText, const QStringList &c
  */
 QRegularExpression createRegularExpression(const QString &txt, int flags, bool isRegExp = true);
 
+/**
+ * @brief isWholeWord
+ * Returns true if there's a word boundary at `start` and at `end`, like a regexp surrounded by `\b`.
+ */
+bool isWholeWord(QStringView text, qsizetype start, qsizetype end);
+
 } // namespace Core
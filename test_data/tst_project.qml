@@ -33,4 +33,23 @@ Script {
         var rcdoc = Project.open("MFC_UpdateGUI.rc")
         compare(rcdoc.type, Document.Rc)
     }
+
+    function test_replaceAllMany() {
+        Project.root = Dir.currentScriptPath + "/projects/cpp-project"
+        var files = ["myobject.h", "myobject.cpp"]
+
+        // Case sensitive, even with PreserveCase: the include isn't changed
+        compare(Project.replaceAllMany(files, {"MyObject": "MyWidget"},
+                                       TextDocument.FindCaseSensitively | TextDocument.FindWholeWords
+                                       | TextDocument.PreserveCase), 9)
+        var source = Project.get("myobject.cpp")
+        compare(source.text.indexOf("MyObject"), -1)
+        verify(source.text.indexOf("#include \"myobject.h\"") !== -1)
+        compare(Project.get("myobject.h").text.indexOf("MyObject"), -1)
+
+        // Case insensitive, the case of each match is kept
+        compare(Project.replaceAllMany(["myobject.cpp"], {"MYOBJECT": "mywidget"},
+                                       TextDocument.FindWholeWords | TextDocument.PreserveCase), 1)
+        verify(source.text.indexOf("#include \"mywidget.h\"") !== -1)
+    }
 }
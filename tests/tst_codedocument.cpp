@@ -14,10 +14,12 @@
 #include "core/lsp_utils.h"
 #include "core/project.h"
 #include "core/querymatch.h"
+#include "core/querymatchiterator.h"
 
 #include <QAction>
 #include <QPlainTextEdit>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QTest>
 #include <kdalgorithms.h>
@@ -419,6 +421,212 @@ private slots:
                       )EOF");
 
         QCOMPARE(matches.size(), 2);
+
+        // The range starts in the middle of the first call, only the calls entirely in the range are found,
+        // in the order of the document.
+        QVERIFY(codedocument->find("sayMessage();"));
+        range = codedocument->createRangeMark(codedocument->selectionStart(), codedocument->positionAt(13, 24));
+        matches = codedocument->queryInRange(range, "(call_expression function: (_) @function)");
+        QCOMPARE(matches.size(), 2);
+        QCOMPARE(matches.at(0).get("function").text(), "object.sayMessage");
+        QCOMPARE(matches.at(1).get("function").text(), "freeFunction");
+    }
+
+    void queryMany()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        const QStringList queries {"(function_definition) @function", "(declaration) @declaration"};
+        const auto results = codedocument->queryMany(queries);
+        QCOMPARE(results.size(), 2);
+
+        // Each list contains the same matches as running the query on its own.
+        for (int i = 0; i < queries.size(); ++i) {
+            const auto matches = results.at(i).value<Core::QueryMatchList>();
+            const auto expected = codedocument->query(queries.at(i));
+            QVERIFY(!matches.isEmpty());
+            QCOMPARE(matches.size(), expected.size());
+            for (int j = 0; j < matches.size(); ++j) {
+                QCOMPARE(matches.at(j).captures().first().range, expected.at(j).captures().first().range);
+            }
+        }
+    }
+
+    void queryCapturesAfterEdit()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        const auto matches = codedocument->query("(function_definition declarator: (_) @declarator) @function");
+        QVERIFY(matches.size() > 1);
+        const auto declarator = matches.last().get("declarator").text();
+        const auto function = matches.last().get("function");
+        const auto start = function.start();
+
+        // The captures follow the changes of the document, even if their ranges are only created afterwards.
+        codedocument->insertAtPosition("// Comment\n", 0);
+        QCOMPARE(function.start(), start + 11);
+        QCOMPARE(matches.last().get("function"), function);
+        QCOMPARE(matches.last().get("declarator").text(), declarator);
+        QCOMPARE(matches.last().getAllJoined("function"), function);
+        QCOMPARE(matches.last().captures().size(), 2);
+        QCOMPARE(matches.last().getInRange("declarator", function).text(), declarator);
+        QVERIFY(!matches.first().getInRange("declarator", function).isValid());
+    }
+
+    void queryCapturesAfterReplaceAll()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        const auto matches = codedocument->query("(function_definition declarator: (_) @declarator) @function");
+        QVERIFY(matches.size() > 2);
+        QStringList declarators;
+        for (const auto &match : matches)
+            declarators.push_back(match.get("declarator").text().replace("unsigned", "uint32_t"));
+
+        // All the matches are replaced in one change, the captures between them are still updated with each of them.
+        QVERIFY(codedocument->replaceAll("unsigned", "uint32_t",
+                                         Core::TextDocument::FindCaseSensitively | Core::TextDocument::FindWholeWords)
+                > 2);
+        for (int i = 0; i < matches.size(); ++i)
+            QCOMPARE(matches.at(i).get("declarator").text(), declarators.at(i));
+    }
+
+    void queryIterator()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        // The iterator returns the same matches as query, in the same order.
+        const QString query = "(function_definition) @function";
+        const auto expected = codedocument->query(query);
+        QVERIFY(expected.size() > 1);
+
+        std::unique_ptr<Core::QueryMatchIterator> iterator(codedocument->queryIterator(query));
+        const auto first = iterator->take(1);
+        QCOMPARE(first.size(), 1);
+        QCOMPARE(first.first().get("function"), expected.first().get("function"));
+        QStringList remaining;
+        while (iterator->hasNext()) {
+            remaining.push_back(iterator->next().get("function").text());
+        }
+        QCOMPARE(remaining.size(), expected.size() - 1);
+        QCOMPARE(remaining.last(), expected.last().get("function").text());
+        QVERIFY(iterator->next().isEmpty());
+        QVERIFY(!iterator->exceededMatchLimit());
+
+        // Modifying the document stops the iteration.
+        iterator.reset(codedocument->queryIterator(query, 10));
+        QVERIFY(iterator->hasNext());
+        codedocument->insertAtPosition("\n", 0);
+        QVERIFY(iterator->hasNext()); // The match fetched ahead is still returned
+        QVERIFY(!iterator->next().isEmpty());
+        QVERIFY(!iterator->hasNext());
+    }
+
+    void incrementalParsing()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        auto functionNames = [codedocument]() {
+            const auto matches = codedocument->query(R"EOF(
+                (function_definition
+                  declarator: (function_declarator
+                    declarator: (_) @name))
+                      )EOF");
+            return kdalgorithms::transformed<QStringList>(matches, [](const Core::QueryMatch &match) {
+                return match.get("name").text();
+            });
+        };
+
+        const auto initialNames = functionNames();
+        QVERIFY(!initialNames.isEmpty());
+
+        // Multi-line insertion in the middle of the document
+        codedocument->gotoLine(2);
+        codedocument->insert("void firstInsertedFunction()\n{\n}\n\n");
+        // Edit on a single line
+        QVERIFY(codedocument->find("firstInsertedFunction"));
+        codedocument->insert("renamedInsertedFunction");
+        // Insertion at the end of the document
+        codedocument->gotoEndOfDocument();
+        codedocument->insert("\nint lastInsertedFunction(int value)\n{\n    return value;\n}\n");
+        // Removal spanning multiple lines
+        QVERIFY(codedocument->find("int lastInsertedFunction"));
+        codedocument->gotoStartOfLine();
+        codedocument->selectNextLine(4);
+        codedocument->deleteSelection();
+
+        const auto incrementalNames = functionNames();
+        QVERIFY(incrementalNames.contains("renamedInsertedFunction"));
+        QVERIFY(!incrementalNames.contains("firstInsertedFunction"));
+        QVERIFY(!incrementalNames.contains("lastInsertedFunction"));
+        QCOMPARE(incrementalNames.size(), initialNames.size() + 1);
+
+        // Setting the whole text parses the document from scratch, the result must be the same.
+        codedocument->setText(codedocument->text());
+        QCOMPARE(functionNames(), incrementalNames);
+    }
+
+    void parseLargeDocument()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        // The document is read in chunks of several blocks while parsing, make sure they are all put together
+        // correctly, including the non-breaking spaces that are turned into spaces by CodeDocument::text.
+        QString text;
+        for (int i = 0; i < 5000; ++i) {
+            text += QString("int function%1()\n{\n    return%2%1;\n}\n\n").arg(i).arg(QChar::Nbsp);
+        }
+        codedocument->setText(text);
+
+        const auto matches = codedocument->query(R"EOF(
+                (function_definition
+                  declarator: (function_declarator
+                    declarator: (_) @name)
+                  body: (compound_statement (return_statement (_) @value)))
+                      )EOF");
+        QCOMPARE(codedocument->parseStatus(), Core::CodeDocument::ParseSucceeded);
+        QCOMPARE(matches.size(), 5000);
+        QCOMPARE(matches.last().get("name").text(), "function4999");
+        QCOMPARE(matches.last().get("value").text(), "4999");
+    }
+
+    void cancelParsingBeforeParse()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+        // The cancellation flag is only checked from time to time, so make sure parsing takes a while.
+        QString text;
+        for (int i = 0; i < 1000; ++i) {
+            text += QString("int function%1() { return %1; }\n").arg(i);
+        }
+        codedocument->setText(text);
+
+        // A cancellation requested before the parse starts isn't lost
+        codedocument->cancelParsing();
+        QCOMPARE(codedocument->parseStatus(), Core::CodeDocument::ParseCancelled);
+
+        // It's consumed by the cancelled parse, the next parse works
+        codedocument->setText(text + "int main() { return 0; }\n");
+        QCOMPARE(codedocument->parseStatus(), Core::CodeDocument::ParseSucceeded);
+
+        // A cancellation requested once the parse is done doesn't apply to the parse needed after an edit
+        codedocument->cancelParsing();
+        QCOMPARE(codedocument->parseStatus(), Core::CodeDocument::ParseSucceeded);
+        codedocument->setText(text);
+        QCOMPARE(codedocument->parseStatus(), Core::CodeDocument::ParseSucceeded);
     }
 
     void ast()
@@ -605,6 +813,41 @@ private slots:
         QCOMPARE(codedocument->selectPreviousSyntaxNode(10), result);
         QCOMPARE(codedocument->selectedText(), "#include <iostream>\n");
     }
+
+    void benchmarkSymbols()
+    {
+        // Synthetic header, with a lot of methods in a single class.
+        QString header = "class Generated\n{\npublic:\n";
+        for (int i = 0; i < 10000; ++i) {
+            header += QString("    void method%1(int value);\n").arg(i);
+        }
+        header += "};\n";
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QFile file(dir.filePath("generated.h"));
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Text));
+        file.write(header.toUtf8());
+        file.close();
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+
+        auto document = qobject_cast<Core::CodeDocument *>(project->open(file.fileName()));
+        QVERIFY(document);
+
+        Core::SymbolList symbols;
+        QBENCHMARK {
+            // Changing the text drops the symbols, so they are computed again.
+            document->setText(header);
+            symbols = document->symbols();
+        }
+        QCOMPARE(symbols.size(), 10001);
+        QCOMPARE(symbols.first()->name(), "Generated");
+        QCOMPARE(symbols.last()->name(), "Generated::method9999");
+        QCOMPARE(symbols.last()->kind(), Core::Symbol::Kind::Method);
+    }
 };
 
 QTEST_MAIN(TestCodeDocument)
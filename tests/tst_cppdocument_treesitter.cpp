@@ -392,6 +392,17 @@ private slots:
             QVERIFY(!match.isEmpty());
             QCOMPARE(match.get("name").text(), "testMethod");
             QCOMPARE(match.get("return").text(), "void");
+
+            // Only the edited lines are scanned again for macros, the other ranges must stay valid
+            document->insertAtLine("  bool AFX_EXT_CLASS m_valid;\n", 9);
+            match = document->queryMember("TestClass", "m_valid");
+            QVERIFY(!match.isEmpty());
+            QCOMPARE(match.getAllJoined("type").text(), "bool");
+            QCOMPARE(match.get("member").text(), "bool AFX_EXT_CLASS m_valid;");
+
+            match = document->queryMember("TestClass", "m_count");
+            QVERIFY(!match.isEmpty());
+            QCOMPARE(match.get("member").text(), "int AFX_EXT_CLASS m_count;");
         });
     }
 };
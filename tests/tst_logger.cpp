@@ -0,0 +1,114 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/test_utils.h"
+#include "core/knutcore.h"
+#include "core/logger.h"
+#include "core/settings.h"
+#include "core/textdocument.h"
+
+#include <QRegularExpression>
+#include <QSignalSpy>
+#include <QTest>
+
+class TestLogger : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void internedNames()
+    {
+        Core::KnutCore core;
+        Core::HistoryModel model;
+        Core::TextDocument document;
+
+        document.gotoLine(1);
+        document.gotoLine(1);
+        QCOMPARE(model.rowCount(), 2);
+
+        // The same name is only stored once
+        const QString first = model.data(model.index(0, Core::HistoryModel::NameCol)).toString();
+        const QString second = model.data(model.index(1, Core::HistoryModel::NameCol)).toString();
+        QCOMPARE(first, "TextDocument::gotoLine");
+        QVERIFY(first.isSharedWith(second));
+    }
+
+    void largeReturnedString()
+    {
+        Core::KnutCore core;
+        Core::HistoryModel model;
+        Core::TextDocument document;
+
+        const QString largeText(2000, 'a');
+        document.setText(largeText);
+        const QString text = document.text();
+        document.setText(text.toUpper());
+        document.setText(text);
+        QCOMPARE(model.rowCount(), 4);
+
+        // The large returned string is only kept as a hash, but is still matched when passed to a later call
+        const QString script = model.createScript(1, 3);
+        QVERIFY(script.contains(R"(var text = document.text)"));
+        QVERIFY(script.contains(QString('"' + largeText.toUpper() + '"')));
+        QVERIFY(!script.contains(largeText));
+        QVERIFY(script.contains(QRegularExpression(R"(document\.text(\(| = )text\)?\n)")));
+    }
+
+    void mapParameter()
+    {
+        Core::KnutCore core;
+        Core::HistoryModel model;
+        Core::TextDocument document;
+
+        document.setText("CString str;\nCStringArray list;");
+        document.replaceAllMany({{"CString", "QString"}, {"CStringArray", "QStringList"}});
+        QCOMPARE(model.rowCount(), 2);
+
+        // Maps are written as javascript objects
+        const QString script = model.createScript(1, 1);
+        QVERIFY(script.contains(R"(document.replaceAllMany({"CString": "QString", "CStringArray": "QStringList"}, 0))"));
+    }
+
+    void removeOldData()
+    {
+        Core::KnutCore core;
+        Core::HistoryModel model;
+        // Limit the history to 1 MB, the model is updated when the project settings are loaded
+        Core::Settings::instance()->loadProjectSettings(Test::testDataPath() + "/tst_logger");
+        Core::TextDocument document;
+        QSignalSpy removedSpy(&model, &QAbstractItemModel::rowsRemoved);
+
+        // Each call uses 400 KB: only the last 2 calls are kept
+        for (const auto c : {'a', 'b', 'c', 'd', 'e'})
+            document.setText(QString(200000, c));
+        QCOMPARE(model.rowCount(), 2);
+        QVERIFY(!removedSpy.isEmpty());
+        for (const auto &arguments : removedSpy)
+            QCOMPARE(arguments.at(1).toInt(), 0);
+
+        document.gotoLine(1);
+        QCOMPARE(model.rowCount(), 3);
+        const QString script = model.createScript(0, 2);
+        QVERIFY(!script.contains(QString(200000, 'c')));
+        QVERIFY(script.contains(QString(200000, 'd')));
+        QVERIFY(script.contains(QString(200000, 'e')));
+        QVERIFY(script.contains("gotoLine(1, 1)"));
+
+        // The last call is always kept, even if it's larger than the limit
+        document.setText(QString(600000, 'f'));
+        QCOMPARE(model.rowCount(), 1);
+        QVERIFY(model.createScript(0, 0).contains(QString(600000, 'f')));
+    }
+};
+
+QTEST_MAIN(TestLogger)
+#include "tst_logger.moc"
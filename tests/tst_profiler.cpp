@@ -0,0 +1,168 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/logger.h"
+#include "core/profiler.h"
+
+#include <QHash>
+#include <QQmlEngine>
+#include <QTest>
+#include <QThread>
+
+///////////////////////////////////////////////////////////////////////////////
+// Tests Data
+///////////////////////////////////////////////////////////////////////////////
+class ProfiledObject : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_INVOKABLE void wait()
+    {
+        LOG("ProfiledObject::wait");
+        QThread::msleep(1);
+    }
+
+    Q_INVOKABLE void waitTwice()
+    {
+        LOG("ProfiledObject::waitTwice");
+        QThread::msleep(1);
+        wait();
+        wait();
+    }
+
+    Q_INVOKABLE void recurse(int depth)
+    {
+        LOG("ProfiledObject::recurse", depth);
+        QThread::msleep(1);
+        if (depth > 0)
+            recurse(depth - 1);
+    }
+};
+
+struct ReportEntry
+{
+    double totalTime = 0;
+    double selfTime = 0;
+    int count = 0;
+};
+
+// Returns the rows of the table `title` in the profiler report
+static QHash<QString, ReportEntry> reportTable(const QString &title)
+{
+    QHash<QString, ReportEntry> entries;
+    const auto tables = Core::Profiler::report().split("\n\n");
+    for (const auto &table : tables) {
+        const auto lines = table.split('\n', Qt::SkipEmptyParts);
+        if (lines.isEmpty() || !lines.first().startsWith(title))
+            continue;
+        const bool hasSelfTime = lines.first().contains("Self");
+        for (const auto &line : lines.mid(1)) {
+            // Names can contain spaces, the numbers are at the end
+            auto words = line.split(' ', Qt::SkipEmptyParts);
+            ReportEntry entry;
+            entry.count = words.takeLast().toInt();
+            if (hasSelfTime)
+                entry.selfTime = words.takeLast().toDouble();
+            entry.totalTime = words.takeLast().toDouble();
+            entries[words.join(' ')] = entry;
+        }
+    }
+    return entries;
+}
+
+// Times are reported in ms with 3 decimals, sums can be off by the rounding
+#define COMPARE_TIME(actual, expected) QVERIFY(qAbs((actual) - (expected)) < 0.0025)
+
+///////////////////////////////////////////////////////////////////////////////
+// Tests
+///////////////////////////////////////////////////////////////////////////////
+class TestProfiler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        Core::Profiler::clear();
+        Core::Profiler::start();
+    }
+
+    void cleanup() { Core::Profiler::stop(); }
+
+    void selfTime()
+    {
+        ProfiledObject object;
+        object.waitTwice();
+
+        const auto apis = reportTable("API");
+        const auto waitTwice = apis.value("ProfiledObject::waitTwice");
+        const auto wait = apis.value("ProfiledObject::wait");
+        QCOMPARE(waitTwice.count, 1);
+        QCOMPARE(wait.count, 2);
+        COMPARE_TIME(wait.totalTime, wait.selfTime);
+        // The self time doesn't include the API calls done by the call
+        COMPARE_TIME(waitTwice.totalTime, waitTwice.selfTime + wait.totalTime);
+        QVERIFY(waitTwice.selfTime > 0);
+    }
+
+    void recursion()
+    {
+        ProfiledObject object;
+        object.recurse(2);
+
+        const auto recurse = reportTable("API").value("ProfiledObject::recurse");
+        QCOMPARE(recurse.count, 3);
+        // Only the outermost call is counted in the total time, which is then the sum of the self times
+        COMPARE_TIME(recurse.totalTime, recurse.selfTime);
+        QVERIFY(recurse.totalTime > 0);
+    }
+
+    void scriptFunctions()
+    {
+        QQmlEngine engine;
+        Core::Profiler::addEngine(&engine);
+        ProfiledObject object;
+        QJSEngine::setObjectOwnership(&object, QJSEngine::CppOwnership);
+        engine.globalObject().setProperty("object", engine.newQObject(&object));
+        Core::Profiler::setDocumentName("main.cpp");
+
+        const QJSValue result = engine.evaluate(R"(
+function inner() {
+    object.wait()
+}
+function outer() {
+    object.wait()
+    object.waitTwice()
+    inner()
+}
+outer()
+)",
+                                                "test.js");
+        Core::Profiler::setDocumentName({});
+        QVERIFY(!result.isError());
+
+        const auto functions = reportTable("Script functions");
+        const auto outer = functions.value("outer (test.js)");
+        const auto inner = functions.value("inner (test.js)");
+        // Only the API calls done directly by the scripts are counted
+        QCOMPARE(outer.count, 2);
+        QCOMPARE(inner.count, 1);
+        COMPARE_TIME(inner.totalTime, inner.selfTime);
+        COMPARE_TIME(outer.totalTime, outer.selfTime + inner.totalTime);
+
+        const auto document = reportTable("Documents").value("main.cpp");
+        QCOMPARE(document.count, 3);
+        COMPARE_TIME(document.totalTime, outer.totalTime);
+    }
+};
+
+QTEST_MAIN(TestProfiler)
+#include "tst_profiler.moc"
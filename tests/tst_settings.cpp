@@ -119,6 +119,22 @@ private slots:
 
         QVERIFY(file.compare());
     }
+
+    void revision()
+    {
+        int previousRevision = 0;
+        {
+            SettingsFixture settings;
+            previousRevision = settings.revision();
+            settings.loadProjectSettings(Test::testDataPath() + "/tst_settings");
+            QVERIFY(settings.revision() > previousRevision);
+            previousRevision = settings.revision();
+        }
+
+        // A new instance, possibly at the same address, never reuses a previous revision
+        SettingsFixture settings;
+        QVERIFY(settings.revision() > previousRevision);
+    }
 };
 
 QTEST_MAIN(TestSettings)
@@ -15,8 +15,12 @@
 #include "core/textdocument.h"
 #include "core/utils.h"
 
+#include <QApplication>
 #include <QDir>
 #include <QFile>
+#include <QPlainTextEdit>
+#include <QRegularExpression>
+#include <QSignalSpy>
 #include <QTest>
 #include <QTextStream>
 
@@ -177,6 +181,52 @@ private slots:
         QCOMPARE(document.currentWord(), "Nulla");
     }
 
+    void positionConversion()
+    {
+        Core::TextDocument document;
+        document.setText("ab\ncd\n\nef");
+
+        QCOMPARE(document.lineAtPosition(4), 2);
+        QCOMPARE(document.columnAtPosition(4), 2);
+        QCOMPARE(document.positionAt(4, 2), 8);
+        QCOMPARE(document.positionAt(5, 1), -1);
+        QCOMPARE(document.lineAtPosition(10), -1);
+
+        auto toLineColumns = [&document](const QList<int> &positions) {
+            QList<std::pair<int, int>> result;
+            for (const auto &value : document.positionsToLineColumns(positions)) {
+                const auto map = value.toMap();
+                result.push_back({map.value("line").toInt(), map.value("column").toInt()});
+            }
+            return result;
+        };
+        using LineColumns = QList<std::pair<int, int>>;
+        QCOMPARE(toLineColumns({0, 2, 3, 6, 9, 10}), LineColumns({{1, 1}, {1, 3}, {2, 1}, {3, 1}, {4, 3}, {-1, -1}}));
+
+        // The lines are kept up to date when editing
+        document.setPosition(1);
+        document.insert("x\ny");
+        QCOMPARE(document.text(), "ax\nyb\ncd\n\nef");
+        QCOMPARE(toLineColumns({0, 4, 6, 10}), LineColumns({{1, 1}, {2, 2}, {3, 1}, {5, 1}}));
+        document.deleteRegion(2, 7);
+        QCOMPARE(document.text(), "axd\n\nef");
+        QCOMPARE(toLineColumns({3, 4, 5, 7}), LineColumns({{1, 4}, {2, 1}, {3, 1}, {3, 3}}));
+        document.undo();
+        QCOMPARE(document.positionAt(5, 2), 11);
+
+        // Editing before and after the previous change
+        document.setText("a\nb\nc\nd");
+        document.setPosition(6);
+        document.insert("\n");
+        document.setPosition(0);
+        document.insert("x\n");
+        QCOMPARE(document.text(), "x\na\nb\nc\n\nd");
+        QCOMPARE(document.positionAt(6, 1), 9);
+        document.deleteRegion(3, 5);
+        QCOMPARE(document.text(), "x\na\nc\n\nd");
+        QCOMPARE(toLineColumns({2, 4, 6, 7, 8}), LineColumns({{2, 1}, {3, 1}, {4, 1}, {5, 1}, {5, 2}}));
+    }
+
     void selection()
     {
         Core::TextDocument document;
@@ -326,6 +376,136 @@ private slots:
         QCOMPARE(other.textExcept(mark), "\nQuisque convallis ipsum ac odio aliquet tincidunt.");
     }
 
+    void manyMarks()
+    {
+        Core::TextDocument document;
+        document.load(Test::testDataPath() + "/tst_textdocument/loremipsum_lf_utf8.txt");
+
+        // Create enough marks to have both sorted and pending marks in the registry.
+        std::vector<Core::Mark> marks;
+        std::vector<int> expected;
+        auto addMarks = [&]() {
+            for (int pos = 0; pos < document.text().size(); pos += 3) {
+                marks.push_back(document.createMark(pos));
+                expected.push_back(pos);
+            }
+        };
+        auto edit = [&](int from, int charsRemoved, const QString &text) {
+            document.deleteRegion(from, from + charsRemoved);
+            document.insertAtPosition(text, from);
+            for (auto &pos : expected) {
+                Core::Mark::updateMark(pos, from, charsRemoved, 0);
+                Core::Mark::updateMark(pos, from, 0, text.size());
+            }
+        };
+        auto checkMarks = [&]() {
+            for (size_t i = 0; i < marks.size(); ++i) {
+                if (marks[i].position() != expected[i])
+                    return false;
+            }
+            return true;
+        };
+
+        addMarks();
+        edit(10, 0, "Hello");
+        edit(100, 25, "");
+        QVERIFY(checkMarks());
+
+        // Destroy half of the marks, and add new ones after the edits.
+        for (size_t i = 0; i < marks.size(); i += 2)
+            marks[i] = {};
+        addMarks();
+        edit(0, 5, "World");
+        edit(200, 50, "Lorem ipsum");
+        for (size_t i = 0; i < marks.size(); ++i) {
+            if (!marks[i].isValid())
+                expected[i] = -1;
+        }
+        QVERIFY(checkMarks());
+
+        auto rangeMark = document.createRangeMark(20, 40);
+        edit(30, 20, "");
+        QCOMPARE(rangeMark.start(), 20);
+        QCOMPARE(rangeMark.end(), 30);
+        QVERIFY(checkMarks());
+    }
+
+    void batchEdit()
+    {
+        Core::TextDocument document;
+        document.setText("0123456789");
+        auto mark = document.createMark(9);
+        QSignalSpy contentsChange(&document, &Core::TextDocument::contentsChange);
+
+        document.insertAtPosition("ab", 2);
+        QCOMPARE(contentsChange.count(), 1);
+        contentsChange.clear();
+
+        document.beginEdit();
+        document.beginEdit();
+        document.insertAtPosition("cd", 2);
+        document.deleteRegion(10, 12);
+        document.endEdit();
+        // The changes are only notified once the outermost batch ends, but marks are up to date.
+        QCOMPARE(contentsChange.count(), 0);
+        QCOMPARE(mark.position(), 11);
+        document.endEdit();
+        QCOMPARE(document.text(), "01cdab234589");
+
+        // The changes are merged into one, replacing "ab234567" with "cdab2345".
+        QCOMPARE(contentsChange.count(), 1);
+        const auto arguments = contentsChange.takeFirst();
+        QCOMPARE(arguments.at(0).toInt(), 2);
+        QCOMPARE(arguments.at(1).toInt(), 8);
+        QCOMPARE(arguments.at(2).toInt(), 8);
+
+        // An unbalanced endEdit is ignored.
+        document.endEdit();
+        document.insertAtPosition("ef", 0);
+        QCOMPARE(contentsChange.count(), 1);
+    }
+
+    void withoutEditor()
+    {
+        const auto widgetCount = QApplication::allWidgets().size();
+
+        Core::TextDocument document;
+        document.setText("0123456789");
+        QSignalSpy positionChanged(&document, &Core::TextDocument::positionChanged);
+        QSignalSpy selectionChanged(&document, &Core::TextDocument::selectionChanged);
+
+        document.gotoNextChar(5);
+        QCOMPARE(positionChanged.count(), 1);
+        QCOMPARE(selectionChanged.count(), 0);
+        document.selectNextChar(2);
+        QCOMPARE(positionChanged.count(), 2);
+        QCOMPARE(selectionChanged.count(), 1);
+        document.insert("ab");
+        QCOMPARE(document.text(), "01234ab789");
+        QCOMPARE(document.position(), 7);
+        QVERIFY(document.selectedText().isEmpty());
+
+        document.deleteRegion(0, 2);
+        QCOMPARE(document.text(), "234ab789");
+        QCOMPARE(document.position(), 0);
+        document.undo();
+        QCOMPARE(document.text(), "01234ab789");
+        document.gotoLine(1, 4);
+        document.indent();
+        QCOMPARE(document.text(), "    01234ab789");
+        QCOMPARE(QApplication::allWidgets().size(), widgetCount);
+
+        // The editor is created on demand, with the current cursor
+        auto textEdit = document.textEdit();
+        QVERIFY(QApplication::allWidgets().size() > widgetCount);
+        QCOMPARE(textEdit->document(), document.document());
+        QCOMPARE(textEdit->textCursor().position(), document.position());
+        positionChanged.clear();
+        document.gotoEndOfLine();
+        QCOMPARE(textEdit->textCursor().position(), 14);
+        QCOMPARE(positionChanged.count(), 1);
+    }
+
     void updateMark()
     {
         int mark = 10;
@@ -413,6 +593,144 @@ private slots:
         }
     }
 
+    void findLiteral()
+    {
+        Core::TextDocument document;
+        document.setText("foobar foo\nFOO");
+        document.gotoStartOfDocument();
+
+        QVERIFY(document.find("foo", Core::TextDocument::FindWholeWords));
+        QCOMPARE(document.selectionStart(), 7);
+        QVERIFY(document.find("foo"));
+        QCOMPARE(document.selectionStart(), 11);
+        QVERIFY(!document.find("foo", Core::TextDocument::FindCaseSensitively));
+
+        document.gotoEndOfDocument();
+        QVERIFY(document.find("foo", Core::TextDocument::FindBackward | Core::TextDocument::FindCaseSensitively));
+        QCOMPARE(document.selectionStart(), 7);
+        QVERIFY(document.find("foo", Core::TextDocument::FindBackward));
+        QCOMPARE(document.selectionStart(), 0);
+
+        // The text searched is updated after each change.
+        document.insertAtPosition("bar", 0);
+        document.gotoStartOfDocument();
+        QVERIFY(document.find("barfoo"));
+        QCOMPARE(document.selectedText(), "barfoo");
+
+        // Whole words are matched like a regexp surrounded by `\b`.
+        document.setText("bar (foo) x(foo)");
+        document.gotoStartOfDocument();
+        QVERIFY(document.find("(foo", Core::TextDocument::FindWholeWords));
+        QCOMPARE(document.selectionStart(), 11);
+        document.gotoStartOfDocument();
+        QVERIFY(document.findRegexp(QRegularExpression::escape("(foo"), Core::TextDocument::FindWholeWords));
+        QCOMPARE(document.selectionStart(), 11);
+
+        // Like QTextDocument::find, a match can't span several lines, and non-breaking spaces are matched as spaces.
+        document.setText("foo\nbar");
+        document.gotoStartOfDocument();
+        QVERIFY(!document.find("o\nb"));
+        document.setText(QString("foo%1bar\u2028baz").arg(QChar::Nbsp));
+        document.gotoStartOfDocument();
+        QVERIFY(document.find("foo bar"));
+        QCOMPARE(document.selectionStart(), 0);
+        document.gotoStartOfDocument();
+        QVERIFY(document.find("bar\u2028b"));
+        QCOMPARE(document.selectionStart(), 4);
+        document.gotoStartOfDocument();
+        QVERIFY(!document.find("bar\nb"));
+
+        // Replacing keeps the text between the matches as is.
+        QCOMPARE(document.replaceAll("ba", "BA", Core::TextDocument::FindCaseSensitively), 2);
+        document.selectRegion(0, 11);
+        QCOMPARE(document.selectedText(), QString("foo%1BAr\u2028BAz").arg(QChar::Nbsp));
+    }
+
+    void replaceAllMarks()
+    {
+        Core::TextDocument document;
+        document.setText("foo bar foo baz foo");
+        auto barMark = document.createMark(4);
+        auto fooMark = document.createMark(8);
+
+        QCOMPARE(document.replaceAll("foo", "hello"), 3);
+        QCOMPARE(document.text(), "hello bar hello baz hello");
+        // The marks between the replacements are moved as if each replacement was done one after the other.
+        QCOMPARE(barMark.position(), 6);
+        QCOMPARE(fooMark.position(), 10);
+
+        // All the replacements are one undo step.
+        document.undo();
+        QCOMPARE(document.text(), "foo bar foo baz foo");
+
+        // Same with replacements on several lines, adding line breaks.
+        document.setText("foo\nbar\nfoo\nbar");
+        auto firstBarMark = document.createMark(5);
+        auto secondFooMark = document.createMark(8);
+        auto secondBarMark = document.createMark(13);
+        QCOMPARE(document.replaceAll("foo", "f\noo"), 2);
+        QCOMPARE(document.text(), "f\noo\nbar\nf\noo\nbar");
+        QCOMPARE(firstBarMark.position(), 6);
+        QCOMPARE(secondFooMark.position(), 9);
+        QCOMPARE(secondBarMark.position(), 15);
+
+        document.setText("aaa");
+        QCOMPARE(document.replaceAll("aa", "b", Core::TextDocument::FindBackward), 1);
+        QCOMPARE(document.text(), "ab");
+    }
+
+    void replaceAllCursor()
+    {
+        Core::TextDocument document;
+        document.setText("foo bar foo baz foo");
+
+        // The cursor and the selection between the replacements are moved like the marks.
+        document.selectRegion(4, 7);
+        QCOMPARE(document.replaceAll("foo", "hello"), 3);
+        QCOMPARE(document.selectionStart(), 6);
+        QCOMPARE(document.selectionEnd(), 9);
+        QCOMPARE(document.selectedText(), "bar");
+
+        document.setText("foo bar foo baz foo");
+        document.setPosition(13);
+        document.replaceAll("foo", "hello");
+        QCOMPARE(document.position(), 17);
+        QCOMPARE(document.currentWord(), "baz");
+
+        // A cursor inside a match is moved to the start of its replacement.
+        document.setText("foo bar foo baz foo");
+        document.setPosition(9);
+        document.replaceAll("foo", "hello");
+        QCOMPARE(document.position(), 10);
+    }
+
+    void replaceAllMany()
+    {
+        Core::TextDocument document;
+        document.setText("CString str;\nCStringArray list;\ncstring lower; MyCString other;");
+
+        // The longest key is used, and only whole words are replaced.
+        const QVariantMap replacements {{"CString", "QString"}, {"CStringArray", "QStringList"}};
+        QCOMPARE(document.replaceAllMany(replacements,
+                                         Core::TextDocument::FindCaseSensitively | Core::TextDocument::FindWholeWords),
+                 2);
+        QCOMPARE(document.text(), "QString str;\nQStringList list;\ncstring lower; MyCString other;");
+
+        document.setText("CString cstring CSTRING");
+        const QVariantMap lowerCaseReplacements {{"cstring", "qstring"}};
+        QCOMPARE(document.replaceAllMany(lowerCaseReplacements, Core::TextDocument::PreserveCase), 3);
+        QCOMPARE(document.text(), "QString qstring QSTRING");
+
+        // Same case rule as replaceAll: FindCaseSensitively is still case sensitive with PreserveCase.
+        const auto caseSensitiveOptions = Core::TextDocument::FindCaseSensitively | Core::TextDocument::PreserveCase;
+        document.setText("CString cstring CSTRING");
+        QCOMPARE(document.replaceAllMany(lowerCaseReplacements, caseSensitiveOptions), 1);
+        QCOMPARE(document.text(), "CString qstring CSTRING");
+        document.setText("CString cstring CSTRING");
+        QCOMPARE(document.replaceAll("cstring", "qstring", caseSensitiveOptions), 1);
+        QCOMPARE(document.text(), "CString qstring CSTRING");
+    }
+
     void findReplaceRegexForwards()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_textdocument/findRegex/findregex.txt");
@@ -644,6 +962,25 @@ private slots:
         document.setText("IDOK:");
         QVERIFY(document.find("IDOK", Core::TextDocument::FindWholeWords));
     }
+
+    void benchmarkSmallCalls()
+    {
+        // Lots of cheap API calls, where the cost of logging each call shows.
+        Core::TextDocument document;
+        document.setText(LoremIpsumText);
+
+        int lineSum = 0;
+        QBENCHMARK {
+            lineSum = 0;
+            document.gotoStartOfDocument();
+            for (int i = 0; i < 10000; ++i) {
+                lineSum += document.lineAtPosition(i % 800);
+                document.gotoNextChar();
+            }
+        }
+        QVERIFY(lineSum > 0);
+        QCOMPARE(document.position(), 888);
+    }
 };
 
 QTEST_MAIN(TestTextDocument)
@@ -0,0 +1,74 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/textdocument.h"
+#include "core/tracer.h"
+#include "utils/json.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestTracer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void save()
+    {
+        Core::Tracer::start();
+        Core::Tracer::setDocumentName("main.cpp");
+        {
+            Core::TextDocument document;
+            document.setText(QString(1000, 'a'));
+            document.gotoLine(1, 2);
+        }
+        Core::Tracer::stop();
+
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("trace.json");
+        QVERIFY(Core::Tracer::save(fileName));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const auto json = nlohmann::json::parse(file.readAll().toStdString(), nullptr, false);
+        QVERIFY(!json.is_discarded());
+        QVERIFY(json.contains("traceEvents"));
+        const auto &events = json["traceEvents"];
+        QVERIFY(events.is_array());
+        QVERIFY(!events.empty());
+
+        bool hasSetText = false;
+        bool hasGotoLine = false;
+        for (const auto &event : events) {
+            QVERIFY(event["ph"] == "X");
+            QVERIFY(event["dur"].get<double>() >= 0);
+            QVERIFY(event["ts"].get<double>() >= 0);
+            QVERIFY(event["args"]["document"] == "main.cpp");
+
+            const auto name = event["name"].get<std::string>();
+            if (name == "TextDocument::text" && event["args"]["depth"].get<int>() == 0) {
+                hasSetText = true;
+                // Large arguments are truncated
+                QVERIFY(event["args"]["arguments"] == std::string(Core::Tracer::MaxArgumentsSize, 'a'));
+            } else if (name == "TextDocument::gotoLine" && event["args"]["depth"].get<int>() == 0) {
+                hasGotoLine = true;
+                QVERIFY(event["args"]["arguments"] == "1, 2");
+            }
+        }
+        QVERIFY(hasSetText);
+        QVERIFY(hasGotoLine);
+    }
+};
+
+QTEST_MAIN(TestTracer)
+#include "tst_tracer.moc"
@@ -13,6 +13,7 @@
 #include "treesitter/parser.h"
 #include "treesitter/predicates.h"
 #include "treesitter/query.h"
+#include "treesitter/query_cache.h"
 #include "treesitter/tree.h"
 
 #include <QTest>
@@ -53,6 +54,77 @@ private slots:
         QCOMPARE(root.namedChildren().size(), 9);
     }
 
+    void childIteration()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        auto root = tree->rootNode();
+
+        // The child ranges return the same nodes as the child lists
+        QList<treesitter::Node> children;
+        for (const auto &child : root.childRange()) {
+            children.push_back(child);
+        }
+        QCOMPARE(children, root.children());
+
+        QList<treesitter::Node> namedChildren;
+        for (const auto &child : root.namedChildRange()) {
+            namedChildren.push_back(child);
+        }
+        QCOMPARE(namedChildren, root.namedChildren());
+
+        // Type ids identify the node types of the language
+        const auto typeIds = treesitter::Node::typeIdsForNames(tree_sitter_cpp(), {"function_definition"});
+        QCOMPARE(typeIds.size(), 1);
+        const auto functions = static_cast<int>(std::ranges::count_if(children, [&typeIds](const auto &child) {
+            return child.typeId() == typeIds.first();
+        }));
+        QCOMPARE(functions, 4);
+        QVERIFY(treesitter::Node::typeIdsForNames(tree_sitter_cpp(), {"not_a_node_type"}).isEmpty());
+
+        const auto main = namedChildren.at(3);
+        QCOMPARE(main.type(), "function_definition");
+        QVERIFY(main.textView(source).startsWith(u"int main(int argc, char *argv[])"));
+        QCOMPARE(main.textView(source).toString(), main.textIn(source));
+
+        // Field names are available while iterating
+        QStringList fieldNames;
+        for (auto it = main.childRange().begin(); it != main.childRange().end(); ++it) {
+            fieldNames.push_back(it.fieldName() ? QString(it.fieldName()) : QString());
+        }
+        QCOMPARE(fieldNames, QStringList({"type", "declarator", "body"}));
+    }
+
+    void cancelParsing()
+    {
+        // The cancellation flag is only checked from time to time, so make sure parsing takes a while.
+        QString source;
+        for (int i = 0; i < 1000; ++i) {
+            source += QString("int function%1() { return %1; }\n").arg(i);
+        }
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        QVERIFY(parser.timeout() == std::chrono::microseconds::zero());
+
+        // A parse cancelled before it starts doesn't return a tree
+        size_t cancelled = 1;
+        parser.setCancellationFlag(&cancelled);
+        QVERIFY(!parser.parseString(source).has_value());
+
+        // Once reset, the parser can parse again
+        parser.reset();
+        cancelled = 0;
+        parser.setTimeout(std::chrono::seconds(10));
+        QVERIFY(parser.timeout() == std::chrono::seconds(10));
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        QCOMPARE(tree->rootNode().namedChildren().size(), 1000);
+        parser.setCancellationFlag(nullptr);
+    }
+
 #define VERIFY_PREDICATE_ERROR(queryString)                                                                            \
     QVERIFY_THROWS_EXCEPTION(Error, treesitter::Query(tree_sitter_cpp(), queryString))
 
@@ -74,6 +146,39 @@ private slots:
         VERIFY_PREDICATE_ERROR("(#non_existing_predicate?)");
     }
 
+    void queryCache()
+    {
+        treesitter::QueryCache cache(2);
+
+        const QString fieldQuery = "(field_expression) @field";
+        auto query = cache.get(tree_sitter_cpp(), fieldQuery);
+        QVERIFY(query);
+        QCOMPARE(cache.statistics().misses, 1u);
+        QCOMPARE(cache.statistics().hits, 0u);
+
+        // Same query text, same language: the compiled query is shared
+        QCOMPARE(cache.get(tree_sitter_cpp(), fieldQuery), query);
+        QCOMPARE(cache.statistics().hits, 1u);
+
+        // Same query text, other language: compiled separately
+        QVERIFY(cache.get(tree_sitter_qmljs(), "(comment) @comment") != query);
+        QCOMPARE(cache.statistics().misses, 2u);
+
+        // Ill-formed queries throw, and are not cached
+        QVERIFY_THROWS_EXCEPTION(treesitter::Query::Error, cache.get(tree_sitter_cpp(), "(field_expr)"));
+        QCOMPARE(cache.size(), 2u);
+
+        // The least recently used query is evicted once the capacity is reached
+        cache.get(tree_sitter_cpp(), fieldQuery);
+        cache.get(tree_sitter_cpp(), "(comment) @comment");
+        QCOMPARE(cache.size(), 2u);
+        cache.resetStatistics();
+        QCOMPARE(cache.get(tree_sitter_cpp(), fieldQuery), query);
+        QCOMPARE(cache.statistics().hits, 1u);
+        cache.get(tree_sitter_qmljs(), "(comment) @comment");
+        QCOMPARE(cache.statistics().misses, 1u);
+    }
+
     void simpleQuery()
     {
         auto source = readTestFile("/tst_treesitter/main.cpp");
@@ -112,6 +217,13 @@ private slots:
         QVERIFY(std::holds_alternative<QString>(arguments.at(1)));
         QCOMPARE(std::get<QString>(arguments.at(1)), "object");
 
+        // The predicates are resolved when the query is constructed
+        const auto &compiledPattern = query->predicateProgram().pattern(0);
+        QCOMPARE(compiledPattern.filters.size(), 1);
+        QVERIFY(compiledPattern.commands.isEmpty());
+        QCOMPARE(compiledPattern.filters.first().captureIds, QList<uint32_t> {captures.at(0).id});
+        QCOMPARE(compiledPattern.filters.first().strings, QStringList {"object"});
+
         treesitter::QueryCursor cursor;
         cursor.execute(query, tree->rootNode(), nullptr /*disable predicates*/);
 
@@ -148,6 +260,43 @@ private slots:
         QVERIFY(!cursor.nextMatch().has_value());
     }
 
+    void combinedQuery()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto query = std::make_shared<treesitter::Query>(
+            tree_sitter_cpp(),
+            QStringList {"(function_definition) @definition", "(field_expression) @field (comment) @comment",
+                         R"EOF((field_expression field: (_) @name (#eq? @name "notAMessage")))EOF"});
+        QCOMPARE(query->subQueryCount(), 3);
+
+        const auto &patterns = query->patterns();
+        QCOMPARE(patterns.size(), 4);
+        QCOMPARE(patterns.at(0).subQuery, 0);
+        QCOMPARE(patterns.at(1).subQuery, 1);
+        QCOMPARE(patterns.at(2).subQuery, 1);
+        QCOMPARE(patterns.at(3).subQuery, 2);
+
+        treesitter::QueryCursor cursor;
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+
+        QList<int> matchCounts(query->subQueryCount(), 0);
+        QList<treesitter::QueryCursor::MatchSink> sinks;
+        for (int i = 0; i < query->subQueryCount(); ++i) {
+            sinks.emplace_back([&matchCounts, i](const treesitter::QueryMatch &) {
+                ++matchCounts[i];
+            });
+        }
+        cursor.dispatchRemainingMatches(sinks);
+
+        // 4 function definitions, 1 field expression and 2 comments, the predicate of the last query never matches
+        QCOMPARE(matchCounts, QList<int>({4, 3, 0}));
+    }
+
     void capture_quantifiers()
     {
         auto source = readTestFile("/tst_treesitter/main.cpp");
@@ -464,6 +613,42 @@ private slots:
         auto matches = cursor.allRemainingMatches();
         QCOMPARE(matches.size(), 1); // Only one function that returns a string, and not an int.
     }
+
+    void benchmarkPredicates()
+    {
+        // tst_cppdocument sized input, scaled up 100 times.
+        const auto testFile = readTestFile("/tst_cppdocument/message_map/TutorialDlg.cpp.original");
+        QVERIFY(!testFile.isEmpty());
+        const auto source = testFile.repeated(100);
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+            (call_expression
+                function: (identifier) @function
+                (#match? "^(DDX|ON)_" @function))
+
+            (call_expression
+                arguments: (argument_list) @arguments
+                (#like? @arguments "(m_hIcon, TRUE)"))
+
+            (function_definition
+                declarator: (function_declarator
+                    declarator: (_) @name
+                    (#eq? @name "CTutorialDlg::OnInitDialog")))
+        )EOF");
+
+        qsizetype matchCount = 0;
+        QBENCHMARK {
+            treesitter::QueryCursor cursor;
+            cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+            matchCount = cursor.allRemainingMatches().size();
+        }
+        // At least the DDX_ calls, the SetIcon call and the function definition of each copy of the file.
+        QVERIFY(matchCount >= 100 * (8 + 1 + 1));
+    }
 };
 
 QTEST_MAIN(TestTreeSitter)